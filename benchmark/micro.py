@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+"""Benchmarks of the reader and pack_command that don't need a server.
+
+Replies are synthetic RESP2 and RESP3 payloads, or captured replies given
+with -f. Results can be saved with --save and compared with a saved run with
+--compare, which exits with status 1 when a benchmark got slower than the
+threshold.
+"""
+
+import json
+import optparse
+import os
+import platform
+import sys
+import timeit
+
+import libvalkey
+
+
+def bulk(data):
+    return b"$%d\r\n%s\r\n" % (len(data), data)
+
+
+def array(items, kind=b"*"):
+    return kind + b"%d\r\n" % len(items) + b"".join(items)
+
+
+def nested_map(depth, width):
+    if depth == 0:
+        return b":1\r\n"
+    items = []
+    for i in range(width):
+        items.append(b"+field%d\r\n" % i)
+        items.append(nested_map(depth - 1, width))
+    return b"%" + b"%d\r\n" % width + b"".join(items)
+
+
+def verbatim(data):
+    return b"=%d\r\ntxt:%s\r\n" % (len(data) + 4, data)
+
+
+# Each operation is reading one reply or packing one command.
+
+# name -> (payload, number of replies, Reader keyword arguments)
+def reader_cases():
+    kb = b"x" * 1024
+    items = [bulk(b"value") for _ in range(100)]
+    fields = []
+    for i in range(50):
+        fields += [bulk(b"field:%d" % i), bulk(b"value:%d" % i)]
+    hash_map = b"%50\r\n" + b"".join(fields)
+
+    return {
+        "resp2/status": (b"+OK\r\n" * 1000, 1000, {}),
+        "resp2/int": (b":12345\r\n" * 1000, 1000, {}),
+        "resp2/bulk-1k": (bulk(kb) * 100, 100, {}),
+        "resp2/bulk-1k-decoded": (bulk(kb) * 100, 100, {"encoding": "utf-8"}),
+        "resp2/blob-10m": (bulk(b"x" * 10 * 1024 * 1024), 1, {}),
+        "resp2/array-int-100": (array([b":%d\r\n" % i for i in range(100)]) * 10, 10, {}),
+        "resp2/lrange-100": (array(items) * 10, 10, {}),
+        "resp2/lrange-100-decoded": (array(items) * 10, 10, {"encoding": "utf-8"}),
+        "resp2/hgetall-50": (array(fields) * 10, 10, {}),
+        "resp3/hgetall-50": (hash_map * 10, 10, {}),
+        "resp3/hgetall-50-decoded": (hash_map * 10, 10, {"encoding": "utf-8"}),
+        "resp3/map-nested": (nested_map(4, 4), 1, {}),
+        "resp3/set-100": (array(items, b"~") * 10, 10, {}),
+        "resp3/verbatim-1k": (verbatim(kb) * 100, 100, {}),
+        "resp3/verbatim-1k-decoded": (verbatim(kb) * 100, 100, {"encoding": "utf-8"}),
+        "resp3/double": (b",3.14159\r\n" * 1000, 1000, {}),
+        "resp3/scalars": (b"_\r\n#t\r\n(12345678901234567890\r\n" * 300, 900, {}),
+    }
+
+
+# name -> command
+def pack_cases():
+    return {
+        "pack/small-ints": ("INCRBY", "counter", 1),
+        "pack/set-str": ("SET", "key", "value"),
+        "pack/set-str-1k": ("SET", "key", "x" * 1024),
+        "pack/set-bytes-1k": ("SET", "key", b"x" * 1024),
+        "pack/set-blob-10m": ("SET", "key", b"x" * 10 * 1024 * 1024),
+        "pack/hset-mixed": ("HSET", "hash") + tuple(
+            v for i in range(20) for v in ("field:%d" % i, (i, i * 0.5, b"v")[i % 3])
+        ),
+        "pack/mget-100": ("MGET",) + tuple("key:%d" % i for i in range(100)),
+    }
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    reader = libvalkey.Reader()
+    reader.feed(data)
+    count = len(reader.gets_many())
+    if reader.has_data():
+        sys.exit("%s: ends with an incomplete reply" % path)
+    return data, count, {}
+
+
+def reader_op(payload, kwargs):
+    reader = libvalkey.Reader(**kwargs)
+    feed = reader.feed
+    gets_many = reader.gets_many
+
+    def op():
+        feed(payload)
+        return gets_many()
+
+    return op
+
+
+def pack_op(cmd):
+    pack_command = libvalkey.pack_command
+
+    def op():
+        return pack_command(cmd)
+
+    return op
+
+
+def blocks_per_op(op, replies):
+    """Memory blocks held by the replies of one call, which is roughly the
+    number of objects created for each of them."""
+    if not hasattr(sys, "getallocatedblocks"):
+        return None
+    op()
+    before = sys.getallocatedblocks()
+    result = op()  # noqa: F841
+    return (sys.getallocatedblocks() - before) / replies
+
+
+def measure(op, replies, size, repeat):
+    timer = timeit.Timer(op)
+    number, _ = timer.autorange()
+    stats = getattr(libvalkey, "allocator_stats", None)
+    before = stats()["allocations"] if stats else 0
+    best = min(timer.repeat(repeat, number))
+    allocations = stats()["allocations"] - before if stats else 0
+
+    return {
+        "ops": replies * number / best,
+        "bytes": size * number / best,
+        "blocks": blocks_per_op(op, replies),
+        "allocations": allocations / (number * repeat * replies),
+    }
+
+
+def format_row(name, result, baseline):
+    blocks = result["blocks"]
+    row = "%-28s %14.0f %10.1f %10s %8.2f" % (
+        name,
+        result["ops"],
+        result["bytes"] / 1024 / 1024,
+        "-" if blocks is None else "%.1f" % blocks,
+        result["allocations"],
+    )
+    if baseline is not None:
+        row += " %+8.1f%%" % ((result["ops"] / baseline["ops"] - 1) * 100)
+    return row
+
+
+def main():
+    parser = optparse.OptionParser(usage="%prog [options]")
+    parser.add_option("-k", dest="match", metavar="TEXT",
+                      help="only run benchmarks whose name contains TEXT")
+    parser.add_option("-r", dest="repeat", metavar="COUNT", type=int, default=5,
+                      help="timing runs per benchmark, the fastest is reported")
+    parser.add_option("-f", dest="files", metavar="FILE", action="append", default=[],
+                      help="benchmark reading the replies captured in FILE")
+    parser.add_option("--save", metavar="FILE", help="save the results as JSON")
+    parser.add_option("--compare", metavar="FILE", help="compare with saved results")
+    parser.add_option("--threshold", metavar="PERCENT", type=float, default=10.0,
+                      help="slowdown that fails --compare (default: %default)")
+    (options, args) = parser.parse_args()
+
+    cases = {}
+    for name, (payload, replies, kwargs) in reader_cases().items():
+        cases[name] = (reader_op(payload, kwargs), replies, len(payload))
+    for path in options.files:
+        payload, replies, kwargs = read_file(path)
+        cases["file/" + os.path.basename(path)] = (reader_op(payload, kwargs), replies, len(payload))
+    for name, cmd in pack_cases().items():
+        op = pack_op(cmd)
+        cases[name] = (op, 1, len(op()))
+
+    baseline = {}
+    if options.compare:
+        with open(options.compare) as f:
+            baseline = json.load(f)["results"]
+
+    print("%-28s %14s %10s %10s %8s" % ("benchmark", "ops/s", "MB/s", "blocks/op", "vk/op"))
+    results = {}
+    regressions = []
+    for name, (op, replies, size) in cases.items():
+        if options.match and options.match not in name:
+            continue
+        results[name] = result = measure(op, replies, size, options.repeat)
+        old = baseline.get(name)
+        print(format_row(name, result, old))
+        if old is not None and result["ops"] < old["ops"] * (1 - options.threshold / 100):
+            regressions.append(name)
+
+    if options.save:
+        with open(options.save, "w") as f:
+            json.dump({
+                "python": platform.python_version(),
+                "implementation": platform.python_implementation(),
+                "results": results,
+            }, f, indent=2)
+
+    if regressions:
+        print("slower than %s: %s" % (options.compare, ", ".join(regressions)))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,17 +1,39 @@
 from libvalkey.libvalkey import (
+    CommandTemplate,
+    LazyList,
+    LazyMap,
     LibvalkeyError,
     ProtocolError,
     Reader,
     ReplyError,
+    ReplyTransform,
+    StreamedReply,
+    allocator_stats,
     pack_command,
+    pack_command_slot,
+    pack_command_vectored,
+    pack_into,
+    pack_pipeline,
+    pack_pipeline_slots,
 )
 from libvalkey.version import __version__
 
 __all__ = [
     "Reader",
+    "CommandTemplate",
+    "LazyList",
+    "LazyMap",
     "LibvalkeyError",
+    "allocator_stats",
     "pack_command",
+    "pack_command_slot",
+    "pack_command_vectored",
+    "pack_into",
+    "pack_pipeline",
+    "pack_pipeline_slots",
     "ProtocolError",
     "ReplyError",
+    "ReplyTransform",
+    "StreamedReply",
     "__version__",
 ]
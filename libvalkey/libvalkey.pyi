@@ -1,9 +1,39 @@
-from typing import Any, Callable, Optional, Tuple, Union
+from array import array
+from typing import Any, Callable, Dict, Iterator, List, Literal, Optional, Sequence, Tuple, Union
 
 class LibvalkeyError(Exception): ...
 class ProtocolError(LibvalkeyError): ...
 class ReplyError(LibvalkeyError): ...
 
+class LazyList:
+    def __len__(self) -> int: ...
+    def __getitem__(self, __index: Union[int, slice]) -> Any: ...
+    def tolist(self) -> List[Any]: ...
+
+class LazyMap:
+    def __len__(self) -> int: ...
+    def __getitem__(self, __key: Any) -> Any: ...
+    def __contains__(self, __key: Any) -> bool: ...
+    def __iter__(self) -> Iterator[Any]: ...
+    def get(self, __key: Any, __default: Any = ...) -> Any: ...
+    def keys(self) -> List[Any]: ...
+    def values(self) -> List[Any]: ...
+    def items(self) -> List[Tuple[Any, Any]]: ...
+    def todict(self) -> dict: ...
+
+class ReplyTransform:
+    def __init__(
+        self,
+        kind: Literal["dict", "pairs", "fields"],
+        fields: Union[Sequence[Union[str, bytes]], Dict[Union[str, bytes], Optional[type]], None] = ...,
+        factory: Optional[Callable[..., Any]] = ...,
+    ) -> None: ...
+
+class StreamedReply:
+    def __init__(self, size: int) -> None: ...
+    @property
+    def size(self) -> int: ...
+
 class Reader:
     def __init__(
         self,
@@ -13,11 +43,35 @@ class Reader:
         errors: Optional[str] = ...,
         notEnoughData: Any = ...,
         convertSetsToLists: bool = ...,
+        lazy: bool = ...,
+        internKeys: int = ...,
+        pushHandler: Optional[Callable[[Any], Any]] = ...,
+        releaseGilThreshold: int = ...,
+        columnar: bool = ...,
+        stats: bool = ...,
+        streamHandler: Optional[Callable[[bytes], Any]] = ...,
+        streamThreshold: int = ...,
+        gcThreshold: int = ...,
+        untrackReplies: bool = ...,
     ) -> None: ...
     def feed(
         self, __buf: Union[str, bytes], __off: int = ..., __len: int = ...
     ) -> None: ...
-    def gets(self, __shouldDecode: bool = ...) -> Any: ...
+    def gets(
+        self, shouldDecode: bool = ..., transform: Optional[ReplyTransform] = ...
+    ) -> Any: ...
+    def gets_many(
+        self,
+        max: Optional[int] = ...,
+        shouldDecode: bool = ...,
+        transform: Optional[ReplyTransform] = ...,
+    ) -> List[Any]: ...
+    def gets_ints(self, max: Optional[int] = ...) -> array[int]: ...
+    def expect_ok(self, max: Optional[int] = ...) -> int: ...
+    def gets_raw(self) -> Union[bytes, Literal[False], Any]: ...
+    def get_buffer(self, __sizehint: int = ...) -> memoryview: ...
+    def commit(self, __nbytes: int) -> None: ...
+    def resolve(self, __waiters: Any, __nbytes: int = ...) -> int: ...
     def setmaxbuf(self, __maxbuf: Optional[int]) -> None: ...
     def getmaxbuf(self) -> int: ...
     def len(self) -> int: ...
@@ -25,5 +79,38 @@ class Reader:
     def set_encoding(
         self, encoding: Optional[str] = ..., errors: Optional[str] = ...
     ) -> None: ...
+    def set_push_handler(self, __handler: Optional[Callable[[Any], Any]]) -> None: ...
+    @property
+    def pushHandler(self) -> Optional[Callable[[Any], Any]]: ...
+    def set_stream_handler(self, __handler: Optional[Callable[[bytes], Any]]) -> None: ...
+    def reset(self, keep: Optional[int] = ...) -> None: ...
+    def stats(self) -> Optional[Dict[str, Any]]: ...
+    def reset_stats(self) -> None: ...
+
+class CommandTemplate:
+    def __init__(self, *args: str | int | float | bytes | bytearray | memoryview | None) -> None: ...
+    def pack(self, *args: str | int | float | bytes | bytearray | memoryview) -> bytes: ...
+    def pack_many(
+        self, rows: Sequence[Tuple[str | int | float | bytes | bytearray | memoryview, ...]]
+    ) -> bytes: ...
 
-def pack_command(cmd: Tuple[str | int | float | bytes | memoryview, ...]) -> bytes: ...
+def pack_command(cmd: Tuple[str | int | float | bytes | bytearray | memoryview, ...]) -> bytes: ...
+def pack_command_slot(
+    cmd: Tuple[str | int | float | bytes | bytearray | memoryview, ...], key_index: int = ...
+) -> Tuple[int, bytes]: ...
+def pack_command_vectored(
+    cmd: Tuple[str | int | float | bytes | bytearray | memoryview, ...], threshold: int = ...
+) -> List[Union[bytes, memoryview]]: ...
+def pack_into(
+    buffer: Union[bytearray, memoryview],
+    offset: int,
+    *args: str | int | float | bytes | bytearray | memoryview,
+) -> int: ...
+def pack_pipeline(
+    commands: Sequence[Tuple[str | int | float | bytes | bytearray | memoryview, ...]]
+) -> bytes: ...
+def pack_pipeline_slots(
+    commands: Sequence[Tuple[str | int | float | bytes | bytearray | memoryview, ...]],
+    key_index: int = ...,
+) -> Tuple[List[int], Dict[int, bytes]]: ...
+def allocator_stats() -> Dict[str, int]: ...
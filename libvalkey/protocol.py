@@ -0,0 +1,65 @@
+"""asyncio protocol that reads replies with a Reader."""
+
+import asyncio
+import collections
+import functools
+from typing import Any, Deque, Optional
+
+from libvalkey.libvalkey import Reader
+
+
+class ReaderProtocol(asyncio.BufferedProtocol):
+    """Protocol that resolves a future for every reply.
+
+    The event loop receives data straight into the reader's buffer, and the
+    replies are read and handed to the pending futures by Reader.resolve(),
+    so no Python code runs for a read or a reply.
+    """
+
+    def __init__(self, reader: Optional[Reader] = None) -> None:
+        self.reader = Reader() if reader is None else reader
+        # Push replies aren't answers to requests, and would otherwise
+        # resolve the next waiter.
+        if self.reader.pushHandler is None:
+            self.reader.set_push_handler(self.push_received)
+        self.waiters: Deque["asyncio.Future[Any]"] = collections.deque()
+        self.transport: Optional[asyncio.Transport] = None
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+        self._exc: Optional[BaseException] = None
+
+        # The event loop looks these up on the instance for every read.
+        self.get_buffer = self.reader.get_buffer  # type: ignore[method-assign]
+        self.buffer_updated = functools.partial(  # type: ignore[method-assign]
+            self.reader.resolve, self.waiters
+        )
+
+    def connection_made(self, transport: asyncio.BaseTransport) -> None:
+        self.transport = transport  # type: ignore[assignment]
+        self._loop = asyncio.get_running_loop()
+
+    def connection_lost(self, exc: Optional[Exception]) -> None:
+        self._exc = exc if exc is not None else ConnectionError("connection lost")
+        while self.waiters:
+            waiter = self.waiters.popleft()
+            if not waiter.done():
+                waiter.set_exception(self._exc)
+
+    def push_received(self, reply: Any) -> None:
+        """Called with RESP3 push replies, such as pub/sub messages or client
+        tracking invalidations, unless the reader has a push handler. Does
+        nothing by default."""
+
+    def request(self, data: bytes) -> "asyncio.Future[Any]":
+        """Send a packed command and return a future of its reply."""
+        if self._exc is not None:
+            raise self._exc
+        if self.transport is None or self._loop is None:
+            raise ConnectionError("not connected")
+
+        waiter = self._loop.create_future()
+        self.waiters.append(waiter)
+        self.transport.write(data)
+        # Replies may have arrived before there was anyone to read them for.
+        if len(self.waiters) == 1 and self.reader.has_data():
+            self.reader.resolve(self.waiters)
+        return waiter
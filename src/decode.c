@@ -0,0 +1,74 @@
+#include "decode.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ASCII_MASK 0x8080808080808080ULL
+
+int Decode_Lookup(const char *encoding) {
+    char name[16];
+    size_t i, len;
+
+    if (encoding == NULL)
+        return DECODE_GENERIC;
+
+    /* Normalize the name like the codec registry does for its aliases. */
+    len = strlen(encoding);
+    if (len >= sizeof(name))
+        return DECODE_GENERIC;
+    for (i = 0; i <= len; i++)
+        name[i] = encoding[i] == '_' ? '-' : (char)tolower((unsigned char)encoding[i]);
+
+    if (strcmp(name, "utf-8") == 0 || strcmp(name, "utf8") == 0)
+        return DECODE_UTF8;
+    if (strcmp(name, "ascii") == 0 || strcmp(name, "us-ascii") == 0)
+        return DECODE_ASCII;
+    if (strcmp(name, "latin-1") == 0 || strcmp(name, "latin1") == 0 ||
+        strcmp(name, "iso-8859-1") == 0 || strcmp(name, "iso8859-1") == 0)
+        return DECODE_LATIN1;
+    return DECODE_GENERIC;
+}
+
+/* Checks eight bytes at a time whether str only contains ASCII. */
+static int is_ascii(const char *str, size_t len) {
+    uint64_t word;
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&word, str + i, 8);
+        if (word & ASCII_MASK)
+            return 0;
+    }
+    for (; i < len; i++) {
+        if ((unsigned char)str[i] & 0x80)
+            return 0;
+    }
+    return 1;
+}
+
+PyObject *Decode_String(int decoder, const char *encoding, const char *errors,
+                        const char *str, size_t len) {
+    PyObject *obj;
+
+    if (decoder == DECODE_GENERIC)
+        return PyUnicode_Decode(str, len, encoding, errors);
+
+    /* ASCII text is the same in all of these encodings, and can be copied
+     * into a compact string without decoding. */
+    if (len > 1 && is_ascii(str, len)) {
+        obj = PyUnicode_New(len, 127);
+        if (obj != NULL)
+            memcpy(PyUnicode_1BYTE_DATA(obj), str, len);
+        return obj;
+    }
+
+    switch (decoder) {
+        case DECODE_UTF8:
+            return PyUnicode_DecodeUTF8(str, len, errors);
+        case DECODE_ASCII:
+            return PyUnicode_DecodeASCII(str, len, errors);
+        default:
+            return PyUnicode_DecodeLatin1(str, len, errors);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef __DECODE_H
+#define __DECODE_H
+
+#include <Python.h>
+
+/* Decoders picked once for an encoding, so decoding doesn't need to look
+ * up the codec by name for each string. */
+enum {
+    DECODE_GENERIC,
+    DECODE_UTF8,
+    DECODE_ASCII,
+    DECODE_LATIN1,
+};
+
+int Decode_Lookup(const char *encoding);
+PyObject *Decode_String(int decoder, const char *encoding, const char *errors,
+                        const char *str, size_t len);
+
+#endif
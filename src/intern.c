@@ -0,0 +1,83 @@
+#include "intern.h"
+
+#include <string.h>
+
+/* FNV-1a, which is good enough for short keys and needs no setup. */
+static size_t intern_hash(const char *str, size_t len, int decoded) {
+    size_t hash = (size_t)14695981039346656037ULL;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= (size_t)1099511628211ULL;
+    }
+    return hash ^ (size_t)decoded;
+}
+
+libvalkey_InternCache *InternCache_New(Py_ssize_t size) {
+    libvalkey_InternCache *cache;
+    size_t slots = 1;
+
+    while (slots < (size_t)size)
+        slots <<= 1;
+
+    cache = PyMem_Malloc(sizeof(*cache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->entries = PyMem_Calloc(slots, sizeof(libvalkey_InternEntry));
+    if (cache->entries == NULL) {
+        PyMem_Free(cache);
+        return NULL;
+    }
+    cache->mask = slots - 1;
+    return cache;
+}
+
+void InternCache_Clear(libvalkey_InternCache *cache) {
+    size_t i;
+
+    for (i = 0; i <= cache->mask; i++)
+        Py_CLEAR(cache->entries[i].obj);
+}
+
+void InternCache_Free(libvalkey_InternCache *cache) {
+    if (cache == NULL)
+        return;
+    InternCache_Clear(cache);
+    PyMem_Free(cache->entries);
+    PyMem_Free(cache);
+}
+
+/* Returns a borrowed reference to the cached object for str, or NULL. */
+PyObject *InternCache_Get(libvalkey_InternCache *cache, const char *str, size_t len, int decoded) {
+    libvalkey_InternEntry *entry;
+    size_t hash;
+
+    if (len > INTERN_MAX_LEN)
+        return NULL;
+
+    hash = intern_hash(str, len, decoded);
+    entry = &cache->entries[hash & cache->mask];
+    if (entry->obj != NULL && entry->hash == hash && entry->len == len &&
+        entry->decoded == decoded && memcmp(entry->data, str, len) == 0)
+        return entry->obj;
+    return NULL;
+}
+
+void InternCache_Put(libvalkey_InternCache *cache, const char *str, size_t len, int decoded, PyObject *obj) {
+    libvalkey_InternEntry *entry;
+    size_t hash;
+
+    if (len > INTERN_MAX_LEN)
+        return;
+
+    hash = intern_hash(str, len, decoded);
+    entry = &cache->entries[hash & cache->mask];
+    Py_INCREF(obj);
+    Py_XSETREF(entry->obj, obj);
+    entry->hash = hash;
+    entry->len = (unsigned char)len;
+    entry->decoded = (unsigned char)decoded;
+    memcpy(entry->data, str, len);
+}
@@ -0,0 +1,30 @@
+#ifndef __INTERN_H
+#define __INTERN_H
+
+#include <Python.h>
+
+/* Strings longer than this are never interned. */
+#define INTERN_MAX_LEN 64
+
+typedef struct {
+    size_t hash;
+    unsigned char len;
+    unsigned char decoded;
+    char data[INTERN_MAX_LEN];
+    PyObject *obj;
+} libvalkey_InternEntry;
+
+/* Direct mapped cache of reply strings by their raw bytes. A new string
+ * replaces the one in its slot, which keeps the cache bounded. */
+typedef struct {
+    libvalkey_InternEntry *entries;
+    size_t mask;
+} libvalkey_InternCache;
+
+libvalkey_InternCache *InternCache_New(Py_ssize_t size);
+void InternCache_Free(libvalkey_InternCache *cache);
+void InternCache_Clear(libvalkey_InternCache *cache);
+PyObject *InternCache_Get(libvalkey_InternCache *cache, const char *str, size_t len, int decoded);
+void InternCache_Put(libvalkey_InternCache *cache, const char *str, size_t len, int decoded, PyObject *obj);
+
+#endif
@@ -0,0 +1,601 @@
+#include "lazy.h"
+#include "libvalkey.h"
+#include "decode.h"
+
+#include <string.h>
+
+static void Lazy_dealloc(libvalkey_LazyObject *self);
+static int Lazy_traverse(libvalkey_LazyObject *self, visitproc visit, void *arg);
+static int Lazy_clear(libvalkey_LazyObject *self);
+static PyObject *Lazy_repr(libvalkey_LazyObject *self);
+static PyObject *LazyList_richcompare(libvalkey_LazyObject *self, PyObject *other, int op);
+static PyObject *LazyMap_richcompare(libvalkey_LazyObject *self, PyObject *other, int op);
+static Py_ssize_t LazyList_length(libvalkey_LazyObject *self);
+static PyObject *LazyList_item(libvalkey_LazyObject *self, Py_ssize_t i);
+static PyObject *LazyList_subscript(libvalkey_LazyObject *self, PyObject *item);
+static PyObject *LazyList_tolist(libvalkey_LazyObject *self, PyObject *unused);
+static Py_ssize_t LazyMap_length(libvalkey_LazyObject *self);
+static PyObject *LazyMap_subscript(libvalkey_LazyObject *self, PyObject *key);
+static int LazyMap_contains(libvalkey_LazyObject *self, PyObject *key);
+static PyObject *LazyMap_iter(libvalkey_LazyObject *self);
+static PyObject *LazyMap_get(libvalkey_LazyObject *self, PyObject *args);
+static PyObject *LazyMap_keys(libvalkey_LazyObject *self, PyObject *unused);
+static PyObject *LazyMap_values(libvalkey_LazyObject *self, PyObject *unused);
+static PyObject *LazyMap_items(libvalkey_LazyObject *self, PyObject *unused);
+static PyObject *LazyMap_todict(libvalkey_LazyObject *self, PyObject *unused);
+
+static PyMethodDef LazyList_methods[] = {
+    {"tolist", (PyCFunction)LazyList_tolist, METH_NOARGS, NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyMethodDef LazyMap_methods[] = {
+    {"get", (PyCFunction)LazyMap_get, METH_VARARGS, NULL},
+    {"keys", (PyCFunction)LazyMap_keys, METH_NOARGS, NULL},
+    {"values", (PyCFunction)LazyMap_values, METH_NOARGS, NULL},
+    {"items", (PyCFunction)LazyMap_items, METH_NOARGS, NULL},
+    {"todict", (PyCFunction)LazyMap_todict, METH_NOARGS, NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyType_Slot LazyList_slots[] = {
+    {Py_tp_dealloc, (void *)Lazy_dealloc},
+    {Py_tp_traverse, (void *)Lazy_traverse},
+    {Py_tp_clear, (void *)Lazy_clear},
+    {Py_tp_repr, (void *)Lazy_repr},
+    {Py_tp_hash, (void *)PyObject_HashNotImplemented},
+    {Py_tp_richcompare, (void *)LazyList_richcompare},
+    {Py_tp_doc, (void *)"Array reply that creates its elements on access"},
+    {Py_tp_methods, LazyList_methods},
+    {Py_sq_length, (void *)LazyList_length},
+    {Py_sq_item, (void *)LazyList_item},
+    {Py_mp_length, (void *)LazyList_length},
+    {Py_mp_subscript, (void *)LazyList_subscript},
+    {0, NULL},
+};
+
+static PyType_Slot LazyMap_slots[] = {
+    {Py_tp_dealloc, (void *)Lazy_dealloc},
+    {Py_tp_traverse, (void *)Lazy_traverse},
+    {Py_tp_clear, (void *)Lazy_clear},
+    {Py_tp_repr, (void *)Lazy_repr},
+    {Py_tp_hash, (void *)PyObject_HashNotImplemented},
+    {Py_tp_richcompare, (void *)LazyMap_richcompare},
+    {Py_tp_iter, (void *)LazyMap_iter},
+    {Py_tp_doc, (void *)"Map reply that creates its keys and values on access"},
+    {Py_tp_methods, LazyMap_methods},
+    {Py_sq_contains, (void *)LazyMap_contains},
+    {Py_mp_length, (void *)LazyMap_length},
+    {Py_mp_subscript, (void *)LazyMap_subscript},
+    {0, NULL},
+};
+
+/* Lazy replies are only created by the reader. */
+#ifdef Py_TPFLAGS_DISALLOW_INSTANTIATION
+#define LAZY_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_DISALLOW_INSTANTIATION)
+#else
+#define LAZY_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC)
+#endif
+
+PyType_Spec libvalkey_LazyListSpec = {
+    MOD_LIBVALKEY ".LazyList",
+    sizeof(libvalkey_LazyObject),
+    0,
+    LAZY_TPFLAGS,
+    LazyList_slots,
+};
+
+PyType_Spec libvalkey_LazyMapSpec = {
+    MOD_LIBVALKEY ".LazyMap",
+    sizeof(libvalkey_LazyObject),
+    0,
+    LAZY_TPFLAGS,
+    LazyMap_slots,
+};
+
+PyObject *Lazy_New(struct libvalkey_ModuleState *state, int map, Py_ssize_t elements,
+                   PyObject *parent, const char *encoding, const char *errors, int decoder) {
+    libvalkey_LazyObject *self;
+
+    self = PyObject_GC_New(libvalkey_LazyObject,
+                           map ? state->LazyMapType : state->LazyListType);
+    if (self == NULL)
+        return NULL;
+
+    self->map = map;
+    self->entries = NULL;
+    self->size = elements;
+    self->filled = 0;
+    self->data = NULL;
+    self->dataLen = 0;
+    self->dataCap = 0;
+    self->encoding = NULL;
+    self->errors = NULL;
+    self->decoder = decoder;
+
+    if (elements > 0) {
+        self->entries = PyMem_Malloc(sizeof(libvalkey_LazyEntry) * elements);
+        if (self->entries == NULL) {
+            Py_DECREF(self);
+            return PyErr_NoMemory();
+        }
+    }
+
+    /* Nested aggregates share the decoding settings of their parent. */
+    if (parent != NULL) {
+        self->encoding = ((libvalkey_LazyObject*)parent)->encoding;
+        self->errors = ((libvalkey_LazyObject*)parent)->errors;
+        self->decoder = ((libvalkey_LazyObject*)parent)->decoder;
+        Py_XINCREF(self->encoding);
+        Py_XINCREF(self->errors);
+    } else if (encoding != NULL) {
+        self->encoding = PyUnicode_FromString(encoding);
+        self->errors = PyUnicode_FromString(errors);
+        if (self->encoding == NULL || self->errors == NULL) {
+            Py_DECREF(self);
+            return NULL;
+        }
+    }
+
+    PyObject_GC_Track(self);
+    return (PyObject*)self;
+}
+
+static libvalkey_LazyEntry *Lazy_next_entry(PyObject *lazy) {
+    libvalkey_LazyObject *self = (libvalkey_LazyObject*)lazy;
+
+    if (self->filled >= self->size) {
+        PyErr_SetString(PyExc_IndexError, "lazy reply is already complete");
+        return NULL;
+    }
+    return &self->entries[self->filled++];
+}
+
+int Lazy_AppendString(PyObject *lazy, const char *str, size_t len) {
+    libvalkey_LazyObject *self = (libvalkey_LazyObject*)lazy;
+    libvalkey_LazyEntry *entry;
+
+    if ((Py_ssize_t)len > self->dataCap - self->dataLen) {
+        Py_ssize_t cap = self->dataCap > 0 ? self->dataCap * 2 : 64;
+        char *data;
+
+        if (cap - self->dataLen < (Py_ssize_t)len)
+            cap = self->dataLen + len;
+        data = PyMem_Realloc(self->data, cap);
+        if (data == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->data = data;
+        self->dataCap = cap;
+    }
+
+    entry = Lazy_next_entry(lazy);
+    if (entry == NULL)
+        return -1;
+
+    memcpy(self->data + self->dataLen, str, len);
+    entry->kind = LAZY_STRING;
+    entry->len = len;
+    entry->value.offset = self->dataLen;
+    self->dataLen += len;
+    return 0;
+}
+
+int Lazy_AppendInteger(PyObject *lazy, long long value) {
+    libvalkey_LazyEntry *entry = Lazy_next_entry(lazy);
+    if (entry == NULL)
+        return -1;
+    entry->kind = LAZY_INTEGER;
+    entry->value.integer = value;
+    return 0;
+}
+
+int Lazy_AppendDouble(PyObject *lazy, double value) {
+    libvalkey_LazyEntry *entry = Lazy_next_entry(lazy);
+    if (entry == NULL)
+        return -1;
+    entry->kind = LAZY_DOUBLE;
+    entry->value.dbl = value;
+    return 0;
+}
+
+int Lazy_AppendBool(PyObject *lazy, int value) {
+    libvalkey_LazyEntry *entry = Lazy_next_entry(lazy);
+    if (entry == NULL)
+        return -1;
+    entry->kind = LAZY_BOOL;
+    entry->value.integer = value;
+    return 0;
+}
+
+int Lazy_AppendNil(PyObject *lazy) {
+    libvalkey_LazyEntry *entry = Lazy_next_entry(lazy);
+    if (entry == NULL)
+        return -1;
+    entry->kind = LAZY_NIL;
+    return 0;
+}
+
+/* Steals a reference to obj. */
+int Lazy_AppendObject(PyObject *lazy, PyObject *obj) {
+    libvalkey_LazyEntry *entry = Lazy_next_entry(lazy);
+    if (entry == NULL) {
+        Py_DECREF(obj);
+        return -1;
+    }
+    entry->kind = LAZY_OBJECT;
+    entry->value.obj = obj;
+    return 0;
+}
+
+static PyObject *Lazy_entry_object(libvalkey_LazyObject *self, libvalkey_LazyEntry *entry) {
+    const char *str;
+
+    switch (entry->kind) {
+        case LAZY_STRING:
+            str = self->data + entry->value.offset;
+            if (self->encoding == NULL)
+                return PyBytes_FromStringAndSize(str, entry->len);
+            return Decode_String(self->decoder, PyUnicode_AsUTF8(self->encoding),
+                                 PyUnicode_AsUTF8(self->errors), str, entry->len);
+        case LAZY_INTEGER:
+            return PyLong_FromLongLong(entry->value.integer);
+        case LAZY_DOUBLE:
+            return PyFloat_FromDouble(entry->value.dbl);
+        case LAZY_BOOL:
+            return PyBool_FromLong((long)entry->value.integer);
+        case LAZY_NIL:
+            Py_RETURN_NONE;
+        default:
+            Py_INCREF(entry->value.obj);
+            return entry->value.obj;
+    }
+}
+
+/* Materializes every step-th entry starting at start into a new list. */
+static PyObject *Lazy_entries_list(libvalkey_LazyObject *self, Py_ssize_t start, Py_ssize_t step) {
+    PyObject *list, *obj;
+    Py_ssize_t i, n;
+
+    list = PyList_New((self->filled - start + step - 1) / step);
+    if (list == NULL)
+        return NULL;
+
+    for (i = start, n = 0; i < self->filled; i += step, n++) {
+        obj = Lazy_entry_object(self, &self->entries[i]);
+        if (obj == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, n, obj);
+    }
+    return list;
+}
+
+static void Lazy_dealloc(libvalkey_LazyObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+
+    PyObject_GC_UnTrack(self);
+    Lazy_clear(self);
+    PyMem_Free(self->entries);
+    PyMem_Free(self->data);
+    type->tp_free((PyObject*)self);
+    Py_DECREF(type);
+}
+
+static int Lazy_traverse(libvalkey_LazyObject *self, visitproc visit, void *arg) {
+    Py_VISIT(Py_TYPE(self));
+    for (Py_ssize_t i = 0; i < self->filled; i++) {
+        if (self->entries[i].kind == LAZY_OBJECT)
+            Py_VISIT(self->entries[i].value.obj);
+    }
+    return 0;
+}
+
+static int Lazy_clear(libvalkey_LazyObject *self) {
+    for (Py_ssize_t i = 0; i < self->filled; i++) {
+        if (self->entries[i].kind == LAZY_OBJECT) {
+            self->entries[i].kind = LAZY_NIL;
+            Py_CLEAR(self->entries[i].value.obj);
+        }
+    }
+    Py_CLEAR(self->encoding);
+    Py_CLEAR(self->errors);
+    return 0;
+}
+
+static PyObject *Lazy_materialize(libvalkey_LazyObject *self) {
+    if (self->map)
+        return LazyMap_todict(self, NULL);
+    return LazyList_tolist(self, NULL);
+}
+
+static PyObject *Lazy_repr(libvalkey_LazyObject *self) {
+    PyObject *obj, *repr;
+
+    obj = Lazy_materialize(self);
+    if (obj == NULL)
+        return NULL;
+    repr = PyUnicode_FromFormat("%s(%R)",
+        self->map ? "LazyMap" : "LazyList", obj);
+    Py_DECREF(obj);
+    return repr;
+}
+
+static PyObject *Lazy_richcompare(libvalkey_LazyObject *self, PyObject *other, int op,
+                                  PyTypeObject *eagerType) {
+    PyObject *obj, *cmp, *otherObj = NULL;
+
+    if (op != Py_EQ && op != Py_NE)
+        Py_RETURN_NOTIMPLEMENTED;
+
+    if (Py_TYPE(other) == Py_TYPE(self)) {
+        otherObj = Lazy_materialize((libvalkey_LazyObject*)other);
+        if (otherObj == NULL)
+            return NULL;
+        other = otherObj;
+    } else if (!PyObject_TypeCheck(other, eagerType)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    obj = Lazy_materialize(self);
+    if (obj == NULL) {
+        Py_XDECREF(otherObj);
+        return NULL;
+    }
+    cmp = PyObject_RichCompare(obj, other, op);
+    Py_DECREF(obj);
+    Py_XDECREF(otherObj);
+    return cmp;
+}
+
+static PyObject *LazyList_richcompare(libvalkey_LazyObject *self, PyObject *other, int op) {
+    return Lazy_richcompare(self, other, op, &PyList_Type);
+}
+
+static PyObject *LazyMap_richcompare(libvalkey_LazyObject *self, PyObject *other, int op) {
+    return Lazy_richcompare(self, other, op, &PyDict_Type);
+}
+
+static Py_ssize_t LazyList_length(libvalkey_LazyObject *self) {
+    return self->filled;
+}
+
+static PyObject *LazyList_item(libvalkey_LazyObject *self, Py_ssize_t i) {
+    if (i < 0 || i >= self->filled) {
+        PyErr_SetString(PyExc_IndexError, "list index out of range");
+        return NULL;
+    }
+    return Lazy_entry_object(self, &self->entries[i]);
+}
+
+static PyObject *LazyList_subscript(libvalkey_LazyObject *self, PyObject *item) {
+    Py_ssize_t i, start, stop, step, length, n;
+    PyObject *list, *obj;
+
+    if (PyIndex_Check(item)) {
+        i = PyNumber_AsSsize_t(item, PyExc_IndexError);
+        if (i == -1 && PyErr_Occurred())
+            return NULL;
+        if (i < 0)
+            i += self->filled;
+        return LazyList_item(self, i);
+    }
+
+    if (!PySlice_Check(item)) {
+        PyErr_Format(PyExc_TypeError, "list indices must be integers or slices, not %.200s",
+                     Py_TYPE(item)->tp_name);
+        return NULL;
+    }
+
+    if (PySlice_Unpack(item, &start, &stop, &step) < 0)
+        return NULL;
+    length = PySlice_AdjustIndices(self->filled, &start, &stop, step);
+
+    list = PyList_New(length);
+    if (list == NULL)
+        return NULL;
+    for (i = start, n = 0; n < length; i += step, n++) {
+        obj = Lazy_entry_object(self, &self->entries[i]);
+        if (obj == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, n, obj);
+    }
+    return list;
+}
+
+static PyObject *LazyList_tolist(libvalkey_LazyObject *self, PyObject *unused) {
+    return Lazy_entries_list(self, 0, 1);
+}
+
+static Py_ssize_t LazyMap_length(libvalkey_LazyObject *self) {
+    return self->filled / 2;
+}
+
+/* Whether str keys can be matched by comparing their encoded form with the
+ * raw key data, which holds when decoding is a strict UTF-8 decode. */
+static int LazyMap_compare_encoded(libvalkey_LazyObject *self) {
+    const char *encoding, *errors;
+
+    encoding = PyUnicode_AsUTF8(self->encoding);
+    errors = PyUnicode_AsUTF8(self->errors);
+    if (encoding == NULL || errors == NULL) {
+        PyErr_Clear();
+        return 0;
+    }
+    return (strcmp(encoding, "utf-8") == 0 || strcmp(encoding, "utf8") == 0) &&
+        strcmp(errors, "strict") == 0;
+}
+
+/* Returns the index of the value for key, -1 when the key is missing and
+ * -2 on errors. Later keys win, like they do when building a dict. */
+static Py_ssize_t LazyMap_find(libvalkey_LazyObject *self, PyObject *key) {
+    libvalkey_LazyEntry *entry;
+    PyObject *obj;
+    const char *keyData = NULL;
+    Py_ssize_t keyLen = 0, i;
+    int stringKey, cmp;
+
+    stringKey = PyBytes_Check(key) || PyUnicode_Check(key);
+
+    if (self->encoding == NULL && PyBytes_Check(key)) {
+        keyData = PyBytes_AS_STRING(key);
+        keyLen = PyBytes_GET_SIZE(key);
+    } else if (self->encoding != NULL && PyUnicode_Check(key) &&
+               LazyMap_compare_encoded(self)) {
+        keyData = PyUnicode_AsUTF8AndSize(key, &keyLen);
+        if (keyData == NULL) {
+            /* Lone surrogates can't be part of a strictly decoded key. */
+            PyErr_Clear();
+            return -1;
+        }
+    }
+
+    for (i = self->filled - 2; i >= 0; i -= 2) {
+        entry = &self->entries[i];
+
+        if (entry->kind == LAZY_STRING && keyData != NULL) {
+            if (entry->len == keyLen &&
+                memcmp(self->data + entry->value.offset, keyData, keyLen) == 0)
+                break;
+            continue;
+        }
+
+        /* Non-string entries never equal str or bytes keys. */
+        if (entry->kind != LAZY_STRING && entry->kind != LAZY_OBJECT && stringKey)
+            continue;
+
+        obj = Lazy_entry_object(self, entry);
+        if (obj == NULL)
+            return -2;
+        cmp = PyObject_RichCompareBool(obj, key, Py_EQ);
+        Py_DECREF(obj);
+        if (cmp < 0)
+            return -2;
+        if (cmp)
+            break;
+    }
+
+    return i < 0 ? -1 : i + 1;
+}
+
+static PyObject *LazyMap_subscript(libvalkey_LazyObject *self, PyObject *key) {
+    Py_ssize_t i = LazyMap_find(self, key);
+
+    if (i == -2)
+        return NULL;
+    if (i == -1) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
+    }
+    return Lazy_entry_object(self, &self->entries[i]);
+}
+
+static int LazyMap_contains(libvalkey_LazyObject *self, PyObject *key) {
+    Py_ssize_t i = LazyMap_find(self, key);
+
+    if (i == -2)
+        return -1;
+    return i >= 0;
+}
+
+static PyObject *LazyMap_iter(libvalkey_LazyObject *self) {
+    PyObject *keys, *iter;
+
+    keys = Lazy_entries_list(self, 0, 2);
+    if (keys == NULL)
+        return NULL;
+    iter = PyObject_GetIter(keys);
+    Py_DECREF(keys);
+    return iter;
+}
+
+static PyObject *LazyMap_get(libvalkey_LazyObject *self, PyObject *args) {
+    PyObject *key, *dflt = Py_None;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "O|O", &key, &dflt))
+        return NULL;
+
+    i = LazyMap_find(self, key);
+    if (i == -2)
+        return NULL;
+    if (i == -1) {
+        Py_INCREF(dflt);
+        return dflt;
+    }
+    return Lazy_entry_object(self, &self->entries[i]);
+}
+
+static PyObject *LazyMap_keys(libvalkey_LazyObject *self, PyObject *unused) {
+    return Lazy_entries_list(self, 0, 2);
+}
+
+static PyObject *LazyMap_values(libvalkey_LazyObject *self, PyObject *unused) {
+    return Lazy_entries_list(self, 1, 2);
+}
+
+static PyObject *LazyMap_items(libvalkey_LazyObject *self, PyObject *unused) {
+    PyObject *items, *key, *value, *pair;
+    Py_ssize_t i;
+
+    items = PyList_New(self->filled / 2);
+    if (items == NULL)
+        return NULL;
+
+    for (i = 0; i + 1 < self->filled; i += 2) {
+        key = Lazy_entry_object(self, &self->entries[i]);
+        if (key == NULL)
+            goto error;
+        value = Lazy_entry_object(self, &self->entries[i + 1]);
+        if (value == NULL) {
+            Py_DECREF(key);
+            goto error;
+        }
+        pair = PyTuple_Pack(2, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (pair == NULL)
+            goto error;
+        PyList_SET_ITEM(items, i / 2, pair);
+    }
+    return items;
+
+error:
+    Py_DECREF(items);
+    return NULL;
+}
+
+static PyObject *LazyMap_todict(libvalkey_LazyObject *self, PyObject *unused) {
+    PyObject *dict, *key, *value;
+    Py_ssize_t i;
+    int ret;
+
+    dict = PyDict_New();
+    if (dict == NULL)
+        return NULL;
+
+    for (i = 0; i + 1 < self->filled; i += 2) {
+        key = Lazy_entry_object(self, &self->entries[i]);
+        if (key == NULL)
+            goto error;
+        value = Lazy_entry_object(self, &self->entries[i + 1]);
+        if (value == NULL) {
+            Py_DECREF(key);
+            goto error;
+        }
+        ret = PyDict_SetItem(dict, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (ret < 0)
+            goto error;
+    }
+    return dict;
+
+error:
+    Py_DECREF(dict);
+    return NULL;
+}
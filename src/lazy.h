@@ -0,0 +1,57 @@
+#ifndef __LAZY_H
+#define __LAZY_H
+
+#include <Python.h>
+#include "libvalkey.h"
+
+/* Kind of a lazy container entry. */
+enum {
+    LAZY_STRING,
+    LAZY_INTEGER,
+    LAZY_DOUBLE,
+    LAZY_BOOL,
+    LAZY_NIL,
+    LAZY_OBJECT,
+};
+
+typedef struct {
+    int kind;
+    Py_ssize_t len;
+    union {
+        Py_ssize_t offset;  /* LAZY_STRING: offset in the data buffer */
+        long long integer;  /* LAZY_INTEGER, LAZY_BOOL */
+        double dbl;         /* LAZY_DOUBLE */
+        PyObject *obj;      /* LAZY_OBJECT: nested aggregate or error */
+    } value;
+} libvalkey_LazyEntry;
+
+/* Aggregate reply whose elements are kept as raw data and only turned into
+ * Python objects when they are accessed. Maps store keys and values as
+ * alternating entries. */
+typedef struct {
+    PyObject_HEAD
+    int map;
+    libvalkey_LazyEntry *entries;
+    Py_ssize_t size;    /* allocated entries */
+    Py_ssize_t filled;  /* entries added by the reader so far */
+    char *data;
+    Py_ssize_t dataLen;
+    Py_ssize_t dataCap;
+    PyObject *encoding; /* str, or NULL to return bytes */
+    PyObject *errors;
+    int decoder;
+} libvalkey_LazyObject;
+
+extern PyType_Spec libvalkey_LazyListSpec;
+extern PyType_Spec libvalkey_LazyMapSpec;
+
+PyObject *Lazy_New(struct libvalkey_ModuleState *state, int map, Py_ssize_t elements,
+                   PyObject *parent, const char *encoding, const char *errors, int decoder);
+int Lazy_AppendString(PyObject *lazy, const char *str, size_t len);
+int Lazy_AppendInteger(PyObject *lazy, long long value);
+int Lazy_AppendDouble(PyObject *lazy, double value);
+int Lazy_AppendBool(PyObject *lazy, int value);
+int Lazy_AppendNil(PyObject *lazy);
+int Lazy_AppendObject(PyObject *lazy, PyObject *obj);
+
+#endif
@@ -1,11 +1,31 @@
 #include "libvalkey.h"
 #include "reader.h"
+#include "lazy.h"
+#include "transform.h"
+#include "streamed.h"
 #include "pack.h"
+#include "memory.h"
+
+#include <string.h>
+
+static struct PyModuleDef libvalkey_ModuleDef;
 
 static int libvalkey_ModuleTraverse(PyObject *m, visitproc visit, void *arg) {
     Py_VISIT(GET_STATE(m)->VkErr_Base);
     Py_VISIT(GET_STATE(m)->VkErr_ProtocolError);
     Py_VISIT(GET_STATE(m)->VkErr_ReplyError);
+    Py_VISIT(GET_STATE(m)->ReaderType);
+    Py_VISIT(GET_STATE(m)->LazyListType);
+    Py_VISIT(GET_STATE(m)->LazyMapType);
+    Py_VISIT(GET_STATE(m)->CommandTemplateType);
+    Py_VISIT(GET_STATE(m)->ReplyTransformType);
+    Py_VISIT(GET_STATE(m)->StreamedReplyType);
+    Py_VISIT(GET_STATE(m)->ArrayType);
+#if PY_VERSION_HEX < 0x030A0000 || defined(PYPY_VERSION)
+    Py_VISIT(GET_STATE(m)->GcIsEnabled);
+    Py_VISIT(GET_STATE(m)->GcEnable);
+    Py_VISIT(GET_STATE(m)->GcDisable);
+#endif
     return 0;
 }
 
@@ -13,71 +33,299 @@ static int libvalkey_ModuleClear(PyObject *m) {
     Py_CLEAR(GET_STATE(m)->VkErr_Base);
     Py_CLEAR(GET_STATE(m)->VkErr_ProtocolError);
     Py_CLEAR(GET_STATE(m)->VkErr_ReplyError);
+    Py_CLEAR(GET_STATE(m)->ReaderType);
+    Py_CLEAR(GET_STATE(m)->LazyListType);
+    Py_CLEAR(GET_STATE(m)->LazyMapType);
+    Py_CLEAR(GET_STATE(m)->CommandTemplateType);
+    Py_CLEAR(GET_STATE(m)->ReplyTransformType);
+    Py_CLEAR(GET_STATE(m)->StreamedReplyType);
+    Py_CLEAR(GET_STATE(m)->ArrayType);
+    Py_CLEAR(GET_STATE(m)->PopleftName);
+    Py_CLEAR(GET_STATE(m)->DoneName);
+    Py_CLEAR(GET_STATE(m)->SetResultName);
+    Py_CLEAR(GET_STATE(m)->SetExceptionName);
+#if PY_VERSION_HEX < 0x030A0000 || defined(PYPY_VERSION)
+    Py_CLEAR(GET_STATE(m)->GcIsEnabled);
+    Py_CLEAR(GET_STATE(m)->GcEnable);
+    Py_CLEAR(GET_STATE(m)->GcDisable);
+#endif
     return 0;
 }
 
+static void libvalkey_ModuleFree(void *m) {
+    libvalkey_ModuleClear((PyObject *)m);
+}
+
+struct libvalkey_ModuleState *libvalkey_GetStateByType(PyTypeObject *type) {
+    PyObject *module;
+
+#if PY_VERSION_HEX >= 0x030B0000 && !defined(PYPY_VERSION)
+    module = PyType_GetModuleByDef(type, &libvalkey_ModuleDef);
+#else
+    /* Subclasses defined in Python don't belong to the module, so look for
+     * the base that does. */
+    PyObject *mro = type->tp_mro;
+    Py_ssize_t i;
+
+    module = NULL;
+    for (i = 0; mro != NULL && i < PyTuple_GET_SIZE(mro); i++) {
+        PyTypeObject *base = (PyTypeObject *)PyTuple_GET_ITEM(mro, i);
+        PyObject *m;
+
+        if (!PyType_HasFeature(base, Py_TPFLAGS_HEAPTYPE))
+            continue;
+        m = PyType_GetModule(base);
+        if (m == NULL) {
+            PyErr_Clear();
+            continue;
+        }
+        if (PyModule_GetDef(m) == &libvalkey_ModuleDef) {
+            module = m;
+            break;
+        }
+    }
+    if (module == NULL)
+        PyErr_Format(PyExc_TypeError, "%s is not a subclass of a libvalkey type",
+                     type->tp_name);
+#endif
+
+    if (module == NULL)
+        return NULL;
+    return GET_STATE(module);
+}
+
 static PyObject*
 py_pack_command(PyObject* self, PyObject* cmd)
 {
     return pack_command(cmd);
 }
 
-PyDoc_STRVAR(pack_command_doc, "Pack a series of arguments into the Valkey protocol");
+static PyObject*
+py_pack_into(PyObject* self, PyObject* args)
+{
+    return pack_into(args);
+}
 
-PyMethodDef pack_command_method = {
-    "pack_command",                 /* The name as a C string. */
-    (PyCFunction) py_pack_command,  /* The C function to invoke. */
-    METH_O,                         /* Flags telling Python how to invoke */
-    pack_command_doc,               /* The docstring as a C string. */
-};
+static PyObject*
+py_pack_pipeline(PyObject* self, PyObject* commands)
+{
+    PyObject *result;
+
+    /* Keep other threads from changing a list of commands while it is
+     * packed from its items. */
+    Py_BEGIN_CRITICAL_SECTION(commands);
+    result = pack_pipeline(commands);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+static PyObject*
+py_pack_command_slot(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    static char *kwlist[] = { "cmd", "key_index", NULL };
+    Py_ssize_t key_index = 1;
+    PyObject *cmd;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|n", kwlist, &cmd, &key_index))
+        return NULL;
+
+    if (key_index < 0) {
+        PyErr_SetString(PyExc_ValueError, "key_index must not be negative");
+        return NULL;
+    }
+
+    return pack_command_slot(cmd, key_index);
+}
+
+static PyObject*
+py_pack_pipeline_slots(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    static char *kwlist[] = { "commands", "key_index", NULL };
+    Py_ssize_t key_index = 1;
+    PyObject *commands, *result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|n", kwlist, &commands, &key_index))
+        return NULL;
 
+    if (key_index < 0) {
+        PyErr_SetString(PyExc_ValueError, "key_index must not be negative");
+        return NULL;
+    }
+
+    Py_BEGIN_CRITICAL_SECTION(commands);
+    result = pack_pipeline_slots(commands, key_index);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+static PyObject*
+py_pack_command_vectored(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    static char *kwlist[] = { "cmd", "threshold", NULL };
+    Py_ssize_t threshold = PACK_VECTORED_THRESHOLD;
+    PyObject *cmd;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|n", kwlist, &cmd, &threshold))
+        return NULL;
+
+    if (threshold < 0) {
+        PyErr_SetString(PyExc_ValueError, "threshold must not be negative");
+        return NULL;
+    }
+
+    return pack_command_vectored(cmd, threshold);
+}
+
+static PyObject*
+py_allocator_stats(PyObject* self, PyObject* unused)
+{
+    return Memory_Stats();
+}
+
+PyDoc_STRVAR(pack_command_doc, "Pack a series of arguments into the Valkey protocol");
+PyDoc_STRVAR(pack_into_doc,
+             "pack_into(buffer, offset, *args)\n\n"
+             "Pack a command into a writable buffer at offset and return the number of bytes written");
+PyDoc_STRVAR(pack_pipeline_doc, "Pack a sequence of commands into a single bytes object");
+PyDoc_STRVAR(pack_command_vectored_doc,
+             "pack_command_vectored(cmd, threshold=16384)\n\n"
+             "Pack a command into a list of buffers for socket.sendmsg() or writelines().\n"
+             "bytes and memoryview arguments of at least threshold bytes are\n"
+             "referenced by memoryviews instead of being copied");
+PyDoc_STRVAR(pack_command_slot_doc,
+             "pack_command_slot(cmd, key_index=1)\n\n"
+             "Pack a command and return (slot, bytes), where slot is the cluster hash slot\n"
+             "of the argument at key_index");
+PyDoc_STRVAR(pack_pipeline_slots_doc,
+             "pack_pipeline_slots(commands, key_index=1)\n\n"
+             "Pack a sequence of commands grouped by the cluster hash slot of the argument\n"
+             "at key_index. Return a list of the slot of each command and a dict of the\n"
+             "packed commands of each slot, in pipeline order");
+PyDoc_STRVAR(allocator_stats_doc,
+             "allocator_stats()\n\n"
+             "Return counters of the memory allocated by the reader's buffers and tasks");
 
 PyMethodDef methods[] = {
     {"pack_command", (PyCFunction) py_pack_command, METH_O, pack_command_doc},
+    {"pack_into", (PyCFunction) py_pack_into, METH_VARARGS, pack_into_doc},
+    {"pack_pipeline", (PyCFunction) py_pack_pipeline, METH_O, pack_pipeline_doc},
+    {"pack_command_slot", (PyCFunction) py_pack_command_slot, METH_VARARGS | METH_KEYWORDS, pack_command_slot_doc},
+    {"pack_pipeline_slots", (PyCFunction) py_pack_pipeline_slots, METH_VARARGS | METH_KEYWORDS, pack_pipeline_slots_doc},
+    {"pack_command_vectored", (PyCFunction) py_pack_command_vectored, METH_VARARGS | METH_KEYWORDS, pack_command_vectored_doc},
+    {"allocator_stats", (PyCFunction) py_allocator_stats, METH_NOARGS, allocator_stats_doc},
     {NULL},
 };
 
+static int libvalkey_AddType(PyObject *module, PyType_Spec *spec, PyTypeObject **type) {
+    *type = (PyTypeObject *)PyType_FromModuleAndSpec(module, spec, NULL);
+    if (*type == NULL)
+        return -1;
+
+    Py_INCREF(*type);
+    if (PyModule_AddObject(module, strrchr(spec->name, '.') + 1, (PyObject *)*type) < 0) {
+        Py_DECREF(*type);
+        return -1;
+    }
+    return 0;
+}
+
+static int libvalkey_AddException(PyObject *module, const char *name, PyObject *base,
+                                  PyObject **exception) {
+    char fullname[64];
+
+    PyOS_snprintf(fullname, sizeof(fullname), MOD_LIBVALKEY ".%s", name);
+    *exception = PyErr_NewException(fullname, base, NULL);
+    if (*exception == NULL)
+        return -1;
+
+    Py_INCREF(*exception);
+    if (PyModule_AddObject(module, name, *exception) < 0) {
+        Py_DECREF(*exception);
+        return -1;
+    }
+    return 0;
+}
+
+static int libvalkey_ModuleExec(PyObject *module) {
+    struct libvalkey_ModuleState *state = GET_STATE(module);
+    PyObject *arraymod;
+#if PY_VERSION_HEX < 0x030A0000 || defined(PYPY_VERSION)
+    PyObject *gcmod;
+#endif
+
+    if (Memory_Install() < 0)
+        return -1;
+
+    /* Setup custom exceptions */
+    if (libvalkey_AddException(module, "LibvalkeyError", PyExc_Exception,
+                               &state->VkErr_Base) < 0 ||
+        libvalkey_AddException(module, "ProtocolError", state->VkErr_Base,
+                               &state->VkErr_ProtocolError) < 0 ||
+        libvalkey_AddException(module, "ReplyError", state->VkErr_Base,
+                               &state->VkErr_ReplyError) < 0)
+        return -1;
+
+    if (libvalkey_AddType(module, &libvalkey_ReaderSpec, &state->ReaderType) < 0 ||
+        libvalkey_AddType(module, &libvalkey_LazyListSpec, &state->LazyListType) < 0 ||
+        libvalkey_AddType(module, &libvalkey_LazyMapSpec, &state->LazyMapType) < 0 ||
+        libvalkey_AddType(module, &libvalkey_CommandTemplateSpec, &state->CommandTemplateType) < 0 ||
+        libvalkey_AddType(module, &libvalkey_ReplyTransformSpec, &state->ReplyTransformType) < 0 ||
+        libvalkey_AddType(module, &libvalkey_StreamedReplySpec, &state->StreamedReplyType) < 0)
+        return -1;
+
+    if ((state->PopleftName = PyUnicode_InternFromString("popleft")) == NULL ||
+        (state->DoneName = PyUnicode_InternFromString("done")) == NULL ||
+        (state->SetResultName = PyUnicode_InternFromString("set_result")) == NULL ||
+        (state->SetExceptionName = PyUnicode_InternFromString("set_exception")) == NULL)
+        return -1;
+
+    arraymod = PyImport_ImportModule("array");
+    if (arraymod == NULL)
+        return -1;
+    state->ArrayType = PyObject_GetAttrString(arraymod, "array");
+    Py_DECREF(arraymod);
+    if (state->ArrayType == NULL)
+        return -1;
+
+#if PY_VERSION_HEX < 0x030A0000 || defined(PYPY_VERSION)
+    gcmod = PyImport_ImportModule("gc");
+    if (gcmod == NULL)
+        return -1;
+    state->GcIsEnabled = PyObject_GetAttrString(gcmod, "isenabled");
+    state->GcEnable = PyObject_GetAttrString(gcmod, "enable");
+    state->GcDisable = PyObject_GetAttrString(gcmod, "disable");
+    Py_DECREF(gcmod);
+    if (state->GcIsEnabled == NULL || state->GcEnable == NULL || state->GcDisable == NULL)
+        return -1;
+#endif
+
+    return 0;
+}
+
+static PyModuleDef_Slot libvalkey_ModuleSlots[] = {
+    {Py_mod_exec, (void *)libvalkey_ModuleExec},
+#if PY_VERSION_HEX >= 0x030C0000 && !defined(PYPY_VERSION)
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#if PY_VERSION_HEX >= 0x030D0000 && !defined(PYPY_VERSION)
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL},
+};
+
 static struct PyModuleDef libvalkey_ModuleDef = {
     PyModuleDef_HEAD_INIT,
     MOD_LIBVALKEY,
     NULL,
     sizeof(struct libvalkey_ModuleState), /* m_size */
     methods, /* m_methods */
-    NULL, /* m_reload */
+    libvalkey_ModuleSlots, /* m_slots */
     libvalkey_ModuleTraverse, /* m_traverse */
     libvalkey_ModuleClear, /* m_clear */
-    NULL /* m_free */
+    libvalkey_ModuleFree /* m_free */
 };
 
-/* Keep pointer around for other classes to access the module state. */
-PyObject *mod_libvalkey;
-
 PyMODINIT_FUNC PyInit_libvalkey(void)
-
 {
-    if (PyType_Ready(&libvalkey_ReaderType) < 0) {
-        return NULL;
-    }
-
-    mod_libvalkey= PyModule_Create(&libvalkey_ModuleDef);
-
-    /* Setup custom exceptions */
-    LIBVALKEY_STATE->VkErr_Base =
-        PyErr_NewException(MOD_LIBVALKEY ".LibvalkeyError", PyExc_Exception, NULL);
-    LIBVALKEY_STATE->VkErr_ProtocolError =
-        PyErr_NewException(MOD_LIBVALKEY ".ProtocolError", LIBVALKEY_STATE->VkErr_Base, NULL);
-    LIBVALKEY_STATE->VkErr_ReplyError =
-        PyErr_NewException(MOD_LIBVALKEY ".ReplyError", LIBVALKEY_STATE->VkErr_Base, NULL);
-
-    Py_INCREF(LIBVALKEY_STATE->VkErr_Base);
-    PyModule_AddObject(mod_libvalkey, "LibvalkeyError", LIBVALKEY_STATE->VkErr_Base);
-    Py_INCREF(LIBVALKEY_STATE->VkErr_ProtocolError);
-    PyModule_AddObject(mod_libvalkey, "ProtocolError", LIBVALKEY_STATE->VkErr_ProtocolError);
-    Py_INCREF(LIBVALKEY_STATE->VkErr_ReplyError);
-    PyModule_AddObject(mod_libvalkey, "ReplyError", LIBVALKEY_STATE->VkErr_ReplyError);
-
-    Py_INCREF(&libvalkey_ReaderType);
-    PyModule_AddObject(mod_libvalkey, "Reader", (PyObject *)&libvalkey_ReaderType);
-
-    return mod_libvalkey;
+    return PyModuleDef_Init(&libvalkey_ModuleDef);
 }
@@ -16,13 +16,45 @@ struct libvalkey_ModuleState {
     PyObject *VkErr_Base;
     PyObject *VkErr_ProtocolError;
     PyObject *VkErr_ReplyError;
+    PyTypeObject *ReaderType;
+    PyTypeObject *LazyListType;
+    PyTypeObject *LazyMapType;
+    PyTypeObject *CommandTemplateType;
+    PyTypeObject *ReplyTransformType;
+    PyTypeObject *StreamedReplyType;
+    /* array.array, which columnar replies are created as. */
+    PyObject *ArrayType;
+    /* Method names used by Reader.resolve. */
+    PyObject *PopleftName;
+    PyObject *DoneName;
+    PyObject *SetResultName;
+    PyObject *SetExceptionName;
+    /* Readers that paused automatic garbage collection, and whether it was
+     * enabled before the first of them did. */
+    Py_ssize_t gcPauses;
+    int gcWasEnabled;
+#ifdef Py_GIL_DISABLED
+    PyMutex gcMutex;
+#endif
+#if PY_VERSION_HEX < 0x030A0000 || defined(PYPY_VERSION)
+    /* gc.isenabled, gc.enable and gc.disable, which there is no C API for. */
+    PyObject *GcIsEnabled;
+    PyObject *GcEnable;
+    PyObject *GcDisable;
+#endif
 };
 
 #define GET_STATE(__s) ((struct libvalkey_ModuleState*)PyModule_GetState(__s))
 
-/* Keep pointer around for other classes to access the module state. */
-extern PyObject *mod_libvalkey;
-#define LIBVALKEY_STATE (GET_STATE(mod_libvalkey))
+/* Returns the state of the module that defined type or one of its bases. */
+struct libvalkey_ModuleState *libvalkey_GetStateByType(PyTypeObject *type);
+
+/* Critical sections only exist on versions that can be built without the
+ * GIL. Everywhere else the GIL already serializes access to objects. */
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
 
 PyMODINIT_FUNC PyInit_libvalkey(void);
 
@@ -0,0 +1,154 @@
+#include "memory.h"
+
+#include <valkey/alloc.h>
+#include <string.h>
+
+/* Interpreters with their own GIL and free-threaded builds allocate at the
+ * same time, so the counters and the installation are atomic. */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MEMORY_ADD(var, n) _InterlockedExchangeAdd64((volatile __int64 *)&(var), (n))
+#define MEMORY_LOAD(var) _InterlockedExchangeAdd64((volatile __int64 *)&(var), 0)
+#define MEMORY_LOAD_INT(var) _InterlockedCompareExchange((volatile long *)&(var), 0, 0)
+#define MEMORY_STORE_INT(var, n) _InterlockedExchange((volatile long *)&(var), (n))
+#define MEMORY_LOAD_PTR(var) _InterlockedCompareExchangePointer((void *volatile *)&(var), NULL, NULL)
+#define MEMORY_CAS_PTR(var, old, new) \
+    (_InterlockedCompareExchangePointer((void *volatile *)&(var), (new), (old)) == (old))
+#else
+#define MEMORY_ADD(var, n) __atomic_fetch_add(&(var), (n), __ATOMIC_RELAXED)
+#define MEMORY_LOAD(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#define MEMORY_LOAD_INT(var) __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define MEMORY_STORE_INT(var, n) __atomic_store_n(&(var), (n), __ATOMIC_RELEASE)
+#define MEMORY_LOAD_PTR(var) __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define MEMORY_CAS_PTR(var, old, new) \
+    __atomic_compare_exchange_n(&(var), &(void *){(old)}, (new), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#endif
+
+/* Each block starts with its size, so the bytes in use can be tracked. The
+ * header keeps the alignment of PyMem_Malloc. */
+#define MEMORY_HEADER 16
+
+static struct {
+    long long allocations;
+    long long reallocations;
+    long long frees;
+    long long bytes;
+} stats;
+
+static void *memory_init(char *block, size_t size) {
+    if (block == NULL)
+        return NULL;
+    *(size_t *)block = size;
+    MEMORY_ADD(stats.bytes, (long long)size);
+    return block + MEMORY_HEADER;
+}
+
+static void *memory_malloc(size_t size) {
+    if (size > PY_SSIZE_T_MAX - MEMORY_HEADER)
+        return NULL;
+    MEMORY_ADD(stats.allocations, 1);
+    return memory_init(PyMem_Malloc(size + MEMORY_HEADER), size);
+}
+
+static void *memory_calloc(size_t nmemb, size_t size) {
+    void *ptr;
+
+    if (size != 0 && nmemb > (PY_SSIZE_T_MAX - MEMORY_HEADER) / size)
+        return NULL;
+    ptr = memory_malloc(nmemb * size);
+    if (ptr != NULL)
+        memset(ptr, 0, nmemb * size);
+    return ptr;
+}
+
+static void *memory_realloc(void *ptr, size_t size) {
+    char *block;
+    size_t old;
+
+    if (ptr == NULL)
+        return memory_malloc(size);
+    if (size > PY_SSIZE_T_MAX - MEMORY_HEADER)
+        return NULL;
+
+    block = (char *)ptr - MEMORY_HEADER;
+    old = *(size_t *)block;
+    block = PyMem_Realloc(block, size + MEMORY_HEADER);
+    if (block == NULL)
+        return NULL;
+
+    MEMORY_ADD(stats.reallocations, 1);
+    MEMORY_ADD(stats.bytes, -(long long)old);
+    return memory_init(block, size);
+}
+
+static char *memory_strdup(const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = memory_malloc(len);
+
+    if (copy != NULL)
+        memcpy(copy, str, len);
+    return copy;
+}
+
+static void memory_free(void *ptr) {
+    char *block;
+
+    if (ptr == NULL)
+        return;
+    block = (char *)ptr - MEMORY_HEADER;
+    MEMORY_ADD(stats.frees, 1);
+    MEMORY_ADD(stats.bytes, -(long long)*(size_t *)block);
+    PyMem_Free(block);
+}
+
+static long installed = 0;
+static PyThread_type_lock install_lock = NULL;
+
+/* Installed once, by the first interpreter that imports the module and
+ * before any reader exists, so libvalkey never frees a block that came from
+ * another allocator. Other interpreters wait on a lock until it is done. */
+int Memory_Install(void) {
+    valkeyAllocFuncs funcs = {
+        memory_malloc,
+        memory_calloc,
+        memory_realloc,
+        memory_strdup,
+        memory_free,
+    };
+    PyThread_type_lock lock;
+
+    if (MEMORY_LOAD_INT(installed))
+        return 0;
+
+    /* The interpreters that get here first race to publish their lock. */
+    lock = MEMORY_LOAD_PTR(install_lock);
+    if (lock == NULL) {
+        lock = PyThread_allocate_lock();
+        if (lock == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        if (!MEMORY_CAS_PTR(install_lock, NULL, lock)) {
+            PyThread_free_lock(lock);
+            lock = MEMORY_LOAD_PTR(install_lock);
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    if (!MEMORY_LOAD_INT(installed)) {
+        valkeySetAllocators(&funcs);
+        MEMORY_STORE_INT(installed, 1);
+    }
+    PyThread_release_lock(lock);
+    return 0;
+}
+
+PyObject *Memory_Stats(void) {
+    return Py_BuildValue("{sLsLsLsL}",
+                         "allocations", (long long)MEMORY_LOAD(stats.allocations),
+                         "reallocations", (long long)MEMORY_LOAD(stats.reallocations),
+                         "frees", (long long)MEMORY_LOAD(stats.frees),
+                         "bytes", (long long)MEMORY_LOAD(stats.bytes));
+}
@@ -0,0 +1,13 @@
+#ifndef __MEMORY_H
+#define __MEMORY_H
+
+#include <Python.h>
+
+/* Makes libvalkey allocate through PyMem_Malloc. Small allocations such as
+ * read tasks and small buffers come from pymalloc's size class pools, and
+ * all of them are visible to tracemalloc. Returns -1 with an exception set
+ * on errors. */
+int Memory_Install(void);
+PyObject *Memory_Stats(void);
+
+#endif
@@ -1,29 +1,288 @@
 #include "pack.h"
-#include "sds.h"
-
-#ifndef _MSC_VER
-#include <valkey/valkey.h>
-#else
-/* Workaround for https://bugs.python.org/issue11717.
- * <valkey/valkey.h> defines ssize_t which can conflict
- * with Python's definition.
- */
-// TODO: remove this workaround when Python 3.10 is required
-extern long long valkeyFormatCommandArgv(char **target, int argc, const char **argv, const size_t *argvlen);
-typedef char *sds;
-extern void sds_free(void *ptr);
-extern sds sdsempty(void);
-extern void sdsfreesplitres(sds *tokens, int count);
-extern sds sdscpylen(sds s, const char *t, size_t len);
-extern sds sdsnewlen(const void *init, size_t initlen);
-#endif
-
-#include <valkey/alloc.h>
+#include "libvalkey.h"
+#include "slot.h"
 
-PyObject *
-pack_command(PyObject *cmd)
+/* Number of arguments that fit in the on-stack array of pack_command. */
+#define PACK_STACK_ARGS 16
+
+/* Serialized bytes of a single command argument. `owner` holds a reference
+ * to a temporary object the bytes belong to, if one had to be created, such
+ * as a memoryview of a buffer. Integers that fit in a long long and floats
+ * are formatted into `digits` instead. */
+typedef struct {
+    const char *buf;
+    Py_ssize_t len;
+    PyObject *owner;
+    char digits[32];
+} pack_arg;
+
+/* Formats value in decimal so that it ends at `end`, and returns where it
+ * starts. */
+static char *
+format_integer(char *end, long long value)
+{
+    unsigned long long v = value < 0 ? 0ULL - (unsigned long long)value
+                                     : (unsigned long long)value;
+    char *p = end;
+
+    do
+    {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    if (value < 0)
+    {
+        *--p = '-';
+    }
+    return p;
+}
+
+static int
+pack_arg_buffer(pack_arg *arg, Py_buffer *view)
+{
+    if (!PyBuffer_IsContiguous(view, 'C'))
+    {
+        PyErr_SetString(PyExc_BufferError, "A buffer argument must be C-contiguous.");
+        return -1;
+    }
+
+    arg->buf = view->buf;
+    arg->len = view->len;
+    return 0;
+}
+
+/* Formats an int, or a subclass of it, by its value. */
+static int
+pack_arg_integer(pack_arg *arg, PyObject *item)
+{
+    int overflow;
+    long long value = PyLong_AsLongLongAndOverflow(item, &overflow);
+
+    if (value == -1 && PyErr_Occurred())
+    {
+        return -1;
+    }
+    if (!overflow)
+    {
+        char *end = arg->digits + sizeof(arg->digits);
+        arg->buf = format_integer(end, value);
+        arg->len = end - arg->buf;
+        return 0;
+    }
+
+    arg->owner = PyLong_Type.tp_repr(item);
+    if (arg->owner == NULL)
+    {
+        return -1;
+    }
+
+    arg->buf = PyUnicode_AsUTF8AndSize(arg->owner, &arg->len);
+    if (arg->buf == NULL)
+    {
+        Py_CLEAR(arg->owner);
+        return -1;
+    }
+    return 0;
+}
+
+/* Formats a float, or a subclass of it, by its value the way repr() does. */
+static int
+pack_arg_float(pack_arg *arg, PyObject *item)
+{
+    char *repr = PyOS_double_to_string(PyFloat_AS_DOUBLE(item), 'r', 0,
+                                       Py_DTSF_ADD_DOT_0, NULL);
+    size_t len;
+
+    if (repr == NULL)
+    {
+        return -1;
+    }
+
+    len = strlen(repr);
+    if (len > sizeof(arg->digits))
+    {
+        /* The shortest repr of a double has at most 24 characters. */
+        PyMem_Free(repr);
+        PyErr_SetString(PyExc_SystemError, "float repr is too long");
+        return -1;
+    }
+    memcpy(arg->digits, repr, len);
+    PyMem_Free(repr);
+    arg->buf = arg->digits;
+    arg->len = (Py_ssize_t)len;
+    return 0;
+}
+
+/* Arguments are bytes, str, bytes-like objects, int and float. Subclasses
+ * of int and float are packed by their value, while bool is rejected
+ * because there is no single way to write it. */
+static int
+pack_arg_init(pack_arg *arg, PyObject *item)
+{
+    arg->owner = NULL;
+
+    if (PyBytes_Check(item))
+    {
+        arg->buf = PyBytes_AS_STRING(item);
+        arg->len = PyBytes_GET_SIZE(item);
+    }
+    else if (PyUnicode_Check(item))
+    {
+        arg->buf = PyUnicode_AsUTF8AndSize(item, &arg->len);
+        if (arg->buf == NULL)
+        {
+            // PyUnicode_AsUTF8AndSize sets an exception.
+            return -1;
+        }
+    }
+    else if (PyMemoryView_Check(item))
+    {
+        return pack_arg_buffer(arg, PyMemoryView_GET_BUFFER(item));
+    }
+    else if (PyLong_Check(item) && !PyBool_Check(item))
+    {
+        return pack_arg_integer(arg, item);
+    }
+    else if (PyFloat_Check(item))
+    {
+        return pack_arg_float(arg, item);
+    }
+    else if (PyObject_CheckBuffer(item))
+    {
+        /* The view keeps objects like bytearray from being resized while
+         * their data is referenced. */
+        arg->owner = PyMemoryView_FromObject(item);
+        if (arg->owner == NULL)
+        {
+            return -1;
+        }
+        if (pack_arg_buffer(arg, PyMemoryView_GET_BUFFER(arg->owner)) < 0)
+        {
+            Py_CLEAR(arg->owner);
+            return -1;
+        }
+    }
+    else
+    {
+        PyErr_Format(PyExc_TypeError,
+                     "A tuple item must be str, int, float or a bytes-like object, not %.100s.",
+                     Py_TYPE(item)->tp_name);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+pack_args_release(pack_arg *args, Py_ssize_t count)
+{
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        Py_XDECREF(args[i].owner);
+    }
+}
+
+static int
+pack_args_init(pack_arg *args, PyObject **items, Py_ssize_t count)
+{
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        if (pack_arg_init(&args[i], items[i]) < 0)
+        {
+            pack_args_release(args, i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static Py_ssize_t
+count_digits(size_t value)
+{
+    Py_ssize_t digits = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+/* Exact size of the RESP encoding of a command, or -1 with an exception set
+ * when it doesn't fit in a Py_ssize_t. */
+static Py_ssize_t
+pack_command_size(const pack_arg *args, Py_ssize_t count)
+{
+    /* *<count>\r\n */
+    size_t size = 1 + count_digits(count) + 2;
+
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        /* $<len>\r\n<arg>\r\n */
+        size_t arg_size = 1 + count_digits(args[i].len) + 2 + args[i].len + 2;
+        if (arg_size > (size_t)PY_SSIZE_T_MAX - size)
+        {
+            PyErr_SetString(PyExc_OverflowError, "command is too large");
+            return -1;
+        }
+        size += arg_size;
+    }
+    return (Py_ssize_t)size;
+}
+
+static char *
+write_header(char *p, char prefix, size_t value)
+{
+    char digits[20];
+    int n = 0;
+
+    *p++ = prefix;
+    do
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0)
+    {
+        *p++ = digits[--n];
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+    return p;
+}
+
+static char *
+pack_command_write_arg(char *p, const pack_arg *arg)
+{
+    p = write_header(p, '$', arg->len);
+    memcpy(p, arg->buf, arg->len);
+    p += arg->len;
+    *p++ = '\r';
+    *p++ = '\n';
+    return p;
+}
+
+/* Writes the RESP encoding of a command to p, which must have room for
+ * pack_command_size() bytes. Returns the end of the written data. */
+static char *
+pack_command_write(char *p, const pack_arg *args, Py_ssize_t count)
+{
+    p = write_header(p, '*', count);
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        p = pack_command_write_arg(p, &args[i]);
+    }
+    return p;
+}
+
+/* Packs a tuple into a bytes object. When key_index isn't negative, the
+ * hash slot of the argument at key_index is stored in *slot. */
+static PyObject *
+pack_command_impl(PyObject *cmd, Py_ssize_t key_index, int *slot)
 {
     assert(cmd);
+    pack_arg stack_args[PACK_STACK_ARGS];
+    pack_arg *args = stack_args;
     PyObject *result = NULL;
 
     if (cmd == NULL || !PyTuple_Check(cmd))
@@ -33,91 +292,853 @@ pack_command(PyObject *cmd)
         return NULL;
     }
 
-    Py_ssize_t tokens_number = PyTuple_Size(cmd);
-    sds *tokens = vk_malloc(sizeof(sds) * tokens_number);
-    if (tokens == NULL)
+    Py_ssize_t tokens_number = PyTuple_GET_SIZE(cmd);
+    if (key_index >= tokens_number)
     {
-        return PyErr_NoMemory();
+        PyErr_SetString(PyExc_IndexError, "key_index out of range");
+        return NULL;
     }
 
-    memset(tokens, 0, sizeof(sds) * tokens_number);
+    if (tokens_number > PACK_STACK_ARGS)
+    {
+        args = PyMem_Malloc(sizeof(pack_arg) * tokens_number);
+        if (args == NULL)
+        {
+            return PyErr_NoMemory();
+        }
+    }
 
-    size_t *lengths = vk_malloc(sizeof(size_t) * tokens_number);
-    if (lengths == NULL)
+    if (pack_args_init(args, &PyTuple_GET_ITEM(cmd, 0), tokens_number) < 0)
     {
-        sds_free(tokens);
-        return PyErr_NoMemory();
+        goto cleanup;
     }
 
-    Py_ssize_t len = 0;
-    for (Py_ssize_t i = 0; i < PyTuple_Size(cmd); i++)
+    if (key_index >= 0)
     {
-        PyObject *item = PyTuple_GetItem(cmd, i);
+        *slot = Slot_Compute(args[key_index].buf, args[key_index].len);
+    }
 
-        if (PyBytes_Check(item))
+    Py_ssize_t size = pack_command_size(args, tokens_number);
+    if (size != -1)
+    {
+        result = PyBytes_FromStringAndSize(NULL, size);
+        if (result != NULL)
         {
-            char *bytes = NULL;
-            Py_buffer buffer;
-            PyObject_GetBuffer(item, &buffer, PyBUF_SIMPLE);
-            PyBytes_AsStringAndSize(item, &bytes, &len);
-            tokens[i] = sdsempty();
-            tokens[i] = sdscpylen(tokens[i], bytes, len);
-            lengths[i] = buffer.len;
-            PyBuffer_Release(&buffer);
+            pack_command_write(PyBytes_AS_STRING(result), args, tokens_number);
         }
-        else if (PyUnicode_Check(item))
+    }
+
+    pack_args_release(args, tokens_number);
+cleanup:
+    if (args != stack_args)
+    {
+        PyMem_Free(args);
+    }
+    return result;
+}
+
+PyObject *
+pack_command(PyObject *cmd)
+{
+    return pack_command_impl(cmd, -1, NULL);
+}
+
+PyObject *
+pack_command_slot(PyObject *cmd, Py_ssize_t key_index)
+{
+    int slot;
+    PyObject *packed = pack_command_impl(cmd, key_index, &slot);
+    if (packed == NULL)
+    {
+        return NULL;
+    }
+    return Py_BuildValue("(iN)", slot, packed);
+}
+
+PyObject *
+pack_into(PyObject *args)
+{
+    pack_arg stack_args[PACK_STACK_ARGS];
+    pack_arg *cmd_args = stack_args;
+    PyObject *result = NULL;
+    Py_buffer buffer;
+    Py_ssize_t offset;
+
+    Py_ssize_t nargs = PyTuple_GET_SIZE(args);
+    if (nargs < 2)
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "pack_into expected a buffer and an offset");
+        return NULL;
+    }
+
+    offset = PyNumber_AsSsize_t(PyTuple_GET_ITEM(args, 1), PyExc_OverflowError);
+    if (offset == -1 && PyErr_Occurred())
+    {
+        return NULL;
+    }
+
+    if (PyObject_GetBuffer(PyTuple_GET_ITEM(args, 0), &buffer, PyBUF_WRITABLE) < 0)
+    {
+        return NULL;
+    }
+
+    Py_ssize_t tokens_number = nargs - 2;
+    if (tokens_number > PACK_STACK_ARGS)
+    {
+        cmd_args = PyMem_Malloc(sizeof(pack_arg) * tokens_number);
+        if (cmd_args == NULL)
         {
-            const char *bytes = PyUnicode_AsUTF8AndSize(item, &len);
-            if (bytes == NULL)
+            PyErr_NoMemory();
+            goto cleanup;
+        }
+    }
+
+    if (pack_args_init(cmd_args, &PyTuple_GET_ITEM(args, 2), tokens_number) < 0)
+    {
+        goto cleanup;
+    }
+
+    Py_ssize_t size = pack_command_size(cmd_args, tokens_number);
+    if (size != -1)
+    {
+        if (offset < 0 || offset > buffer.len || size > buffer.len - offset)
+        {
+            PyErr_Format(PyExc_ValueError,
+                         "pack_into requires a buffer of at least %zd bytes "
+                         "at offset %zd", size, offset);
+        }
+        else
+        {
+            pack_command_write((char *)buffer.buf + offset, cmd_args, tokens_number);
+            result = PyLong_FromSsize_t(size);
+        }
+    }
+
+    pack_args_release(cmd_args, tokens_number);
+cleanup:
+    if (cmd_args != stack_args)
+    {
+        PyMem_Free(cmd_args);
+    }
+    PyBuffer_Release(&buffer);
+    return result;
+}
+
+PyObject *
+pack_pipeline(PyObject *commands)
+{
+    PyObject *result = NULL;
+    pack_arg *args = NULL;
+    Py_ssize_t args_number = 0;
+    Py_ssize_t size = 0;
+
+    PyObject *seq = PySequence_Fast(commands, "commands must be a sequence of tuples");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+
+    Py_ssize_t commands_number = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+
+    for (Py_ssize_t i = 0; i < commands_number; i++)
+    {
+        if (!PyTuple_Check(items[i]))
+        {
+            PyErr_SetString(PyExc_TypeError,
+                            "The argument must be a tuple of str, int, float or bytes.");
+            goto cleanup;
+        }
+        args_number += PyTuple_GET_SIZE(items[i]);
+    }
+
+    args = PyMem_Malloc(sizeof(pack_arg) * (args_number ? args_number : 1));
+    if (args == NULL)
+    {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+
+    Py_ssize_t initialized = 0;
+    for (Py_ssize_t i = 0; i < commands_number; i++)
+    {
+        Py_ssize_t tokens_number = PyTuple_GET_SIZE(items[i]);
+        if (pack_args_init(&args[initialized], &PyTuple_GET_ITEM(items[i], 0), tokens_number) < 0)
+        {
+            pack_args_release(args, initialized);
+            goto cleanup;
+        }
+
+        Py_ssize_t cmd_size = pack_command_size(&args[initialized], tokens_number);
+        initialized += tokens_number;
+        if (cmd_size == -1 || cmd_size > PY_SSIZE_T_MAX - size)
+        {
+            if (cmd_size != -1)
             {
-                // PyUnicode_AsUTF8AndSize sets an exception.
-                goto cleanup;
+                PyErr_SetString(PyExc_OverflowError, "pipeline is too large");
             }
+            pack_args_release(args, initialized);
+            goto cleanup;
+        }
+        size += cmd_size;
+    }
 
-            tokens[i] = sdsnewlen(bytes, len);
-            lengths[i] = len;
+    result = PyBytes_FromStringAndSize(NULL, size);
+    if (result != NULL)
+    {
+        char *p = PyBytes_AS_STRING(result);
+        pack_arg *cmd_args = args;
+        for (Py_ssize_t i = 0; i < commands_number; i++)
+        {
+            Py_ssize_t tokens_number = PyTuple_GET_SIZE(items[i]);
+            p = pack_command_write(p, cmd_args, tokens_number);
+            cmd_args += tokens_number;
         }
-        else if (PyMemoryView_Check(item))
+    }
+
+    pack_args_release(args, args_number);
+cleanup:
+    PyMem_Free(args);
+    Py_DECREF(seq);
+    return result;
+}
+
+/* A command of pack_pipeline_slots, which are sorted by slot and then by
+ * their position in the pipeline. */
+typedef struct {
+    int slot;
+    Py_ssize_t index;
+    Py_ssize_t size;
+    Py_ssize_t tokens_number;
+    pack_arg *args;
+} pack_slot_command;
+
+static int
+pack_slot_command_compare(const void *a, const void *b)
+{
+    const pack_slot_command *x = a;
+    const pack_slot_command *y = b;
+
+    if (x->slot != y->slot)
+    {
+        return x->slot < y->slot ? -1 : 1;
+    }
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* Packs the commands of each slot into one bytes object. Returns a list of
+ * the slot of each command and a dict of the packed commands by slot. */
+PyObject *
+pack_pipeline_slots(PyObject *commands, Py_ssize_t key_index)
+{
+    PyObject *result = NULL, *slots = NULL, *buffers = NULL;
+    pack_slot_command *cmds = NULL;
+    pack_arg *args = NULL;
+    Py_ssize_t args_number = 0;
+    Py_ssize_t initialized = 0;
+
+    PyObject *seq = PySequence_Fast(commands, "commands must be a sequence of tuples");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+
+    Py_ssize_t commands_number = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+
+    for (Py_ssize_t i = 0; i < commands_number; i++)
+    {
+        if (!PyTuple_Check(items[i]))
         {
-            Py_buffer *p_buf = PyMemoryView_GET_BUFFER(item);
-            tokens[i] = sdsnewlen(p_buf->buf, p_buf->len);
-            lengths[i] = p_buf->len;
+            PyErr_SetString(PyExc_TypeError,
+                            "The argument must be a tuple of str, int, float or bytes.");
+            goto cleanup;
         }
-        else
+        if (key_index >= PyTuple_GET_SIZE(items[i]))
         {
-            if (PyLong_CheckExact(item) || PyFloat_Check(item))
-            {
-                PyObject *repr = PyObject_Repr(item);
-                const char *bytes = PyUnicode_AsUTF8AndSize(repr, &len);
+            PyErr_SetString(PyExc_IndexError, "key_index out of range");
+            goto cleanup;
+        }
+        args_number += PyTuple_GET_SIZE(items[i]);
+    }
 
-                tokens[i] = sdsnewlen(bytes, len);
-                lengths[i] = len;
-                Py_DECREF(repr);
-            }
-            else
+    args = PyMem_Malloc(sizeof(pack_arg) * (args_number ? args_number : 1));
+    cmds = PyMem_Malloc(sizeof(pack_slot_command) * (commands_number ? commands_number : 1));
+    slots = PyList_New(commands_number);
+    buffers = PyDict_New();
+    if (args == NULL || cmds == NULL)
+    {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+    if (slots == NULL || buffers == NULL)
+    {
+        goto cleanup;
+    }
+
+    for (Py_ssize_t i = 0; i < commands_number; i++)
+    {
+        pack_slot_command *cmd = &cmds[i];
+
+        cmd->index = i;
+        cmd->args = &args[initialized];
+        cmd->tokens_number = PyTuple_GET_SIZE(items[i]);
+        if (pack_args_init(cmd->args, &PyTuple_GET_ITEM(items[i], 0), cmd->tokens_number) < 0)
+        {
+            goto cleanup;
+        }
+        initialized += cmd->tokens_number;
+
+        cmd->size = pack_command_size(cmd->args, cmd->tokens_number);
+        if (cmd->size == -1)
+        {
+            goto cleanup;
+        }
+
+        cmd->slot = Slot_Compute(cmd->args[key_index].buf, cmd->args[key_index].len);
+        PyObject *slot = PyLong_FromLong(cmd->slot);
+        if (slot == NULL)
+        {
+            goto cleanup;
+        }
+        PyList_SET_ITEM(slots, i, slot);
+    }
+
+    qsort(cmds, commands_number, sizeof(pack_slot_command), pack_slot_command_compare);
+
+    for (Py_ssize_t start = 0, end; start < commands_number; start = end)
+    {
+        Py_ssize_t size = 0;
+
+        for (end = start; end < commands_number && cmds[end].slot == cmds[start].slot; end++)
+        {
+            if (cmds[end].size > PY_SSIZE_T_MAX - size)
             {
-                PyErr_SetString(PyExc_TypeError,
-                                "A tuple item must be str, int, float or bytes.");
+                PyErr_SetString(PyExc_OverflowError, "pipeline is too large");
                 goto cleanup;
             }
+            size += cmds[end].size;
+        }
+
+        PyObject *packed = PyBytes_FromStringAndSize(NULL, size);
+        if (packed == NULL)
+        {
+            goto cleanup;
+        }
+
+        char *p = PyBytes_AS_STRING(packed);
+        for (Py_ssize_t i = start; i < end; i++)
+        {
+            p = pack_command_write(p, cmds[i].args, cmds[i].tokens_number);
         }
+
+        PyObject *slot = PyList_GET_ITEM(slots, cmds[start].index);
+        int ret = PyDict_SetItem(buffers, slot, packed);
+        Py_DECREF(packed);
+        if (ret < 0)
+        {
+            goto cleanup;
+        }
+    }
+
+    result = PyTuple_Pack(2, slots, buffers);
+
+cleanup:
+    pack_args_release(args, initialized);
+    PyMem_Free(args);
+    PyMem_Free(cmds);
+    Py_XDECREF(slots);
+    Py_XDECREF(buffers);
+    Py_DECREF(seq);
+    return result;
+}
+
+/* Size of the data copied into the chunk of a vectored command that spans
+ * the arguments [start, end). The chunk begins with the command header or
+ * the line break after the previous, referenced argument and ends with the
+ * header of the argument at `end`, if there is one. */
+static Py_ssize_t
+pack_chunk_size(const pack_arg *args, Py_ssize_t count, Py_ssize_t start, Py_ssize_t end)
+{
+    Py_ssize_t size = start == 0 ? 1 + count_digits(count) + 2 : 2;
+
+    for (Py_ssize_t i = start; i < end; i++)
+    {
+        size += 1 + count_digits(args[i].len) + 2 + args[i].len + 2;
+    }
+    if (end < count)
+    {
+        size += 1 + count_digits(args[end].len) + 2;
+    }
+    return size;
+}
+
+static int
+pack_append_chunk(PyObject *result, const pack_arg *args, Py_ssize_t count,
+                  Py_ssize_t start, Py_ssize_t end)
+{
+    PyObject *chunk = PyBytes_FromStringAndSize(NULL, pack_chunk_size(args, count, start, end));
+    if (chunk == NULL)
+    {
+        return -1;
+    }
+
+    char *p = PyBytes_AS_STRING(chunk);
+    if (start == 0)
+    {
+        p = write_header(p, '*', count);
+    }
+    else
+    {
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    for (Py_ssize_t i = start; i < end; i++)
+    {
+        p = write_header(p, '$', args[i].len);
+        memcpy(p, args[i].buf, args[i].len);
+        p += args[i].len;
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    if (end < count)
+    {
+        write_header(p, '$', args[end].len);
     }
 
-    char *resp_bytes = NULL;
+    int ret = PyList_Append(result, chunk);
+    Py_DECREF(chunk);
+    return ret;
+}
+
+PyObject *
+pack_command_vectored(PyObject *cmd, Py_ssize_t threshold)
+{
+    pack_arg stack_args[PACK_STACK_ARGS];
+    pack_arg *args = stack_args;
+    PyObject *result = NULL;
 
-    len = valkeyFormatCommandArgv(&resp_bytes, tokens_number, (const char **)tokens, lengths);
+    if (!PyTuple_Check(cmd))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "The argument must be a tuple of str, int, float or bytes.");
+        return NULL;
+    }
+
+    Py_ssize_t tokens_number = PyTuple_GET_SIZE(cmd);
+    if (tokens_number > PACK_STACK_ARGS)
+    {
+        args = PyMem_Malloc(sizeof(pack_arg) * tokens_number);
+        if (args == NULL)
+        {
+            return PyErr_NoMemory();
+        }
+    }
 
-    if (len == -1)
+    if (pack_args_init(args, &PyTuple_GET_ITEM(cmd, 0), tokens_number) < 0)
     {
-        PyErr_SetString(PyExc_RuntimeError,
-                        "Failed to serialize the command.");
         goto cleanup;
     }
 
-    result = PyBytes_FromStringAndSize(resp_bytes, len);
-    vk_free(resp_bytes);
+    if (pack_command_size(args, tokens_number) == -1)
+    {
+        goto release;
+    }
+
+    result = PyList_New(0);
+    if (result == NULL)
+    {
+        goto release;
+    }
+
+    /* Large bytes-like arguments are referenced instead of copied, the data
+     * in between is gathered into bytes objects. */
+    Py_ssize_t start = 0;
+    for (Py_ssize_t i = 0; i < tokens_number; i++)
+    {
+        PyObject *item = PyTuple_GET_ITEM(cmd, i);
+        PyObject *view;
+
+        if (args[i].len < threshold || args[i].len == 0)
+        {
+            continue;
+        }
+
+        if (PyBytes_Check(item))
+        {
+            view = PyMemoryView_FromObject(item);
+            if (view == NULL)
+            {
+                goto error;
+            }
+        }
+        else if (PyMemoryView_Check(item))
+        {
+            Py_INCREF(item);
+            view = item;
+        }
+        else if (args[i].owner != NULL && PyMemoryView_Check(args[i].owner))
+        {
+            Py_INCREF(args[i].owner);
+            view = args[i].owner;
+        }
+        else
+        {
+            continue;
+        }
+
+        if (pack_append_chunk(result, args, tokens_number, start, i) < 0 ||
+            PyList_Append(result, view) < 0)
+        {
+            Py_DECREF(view);
+            goto error;
+        }
+        Py_DECREF(view);
+        start = i + 1;
+    }
+
+    if (pack_append_chunk(result, args, tokens_number, start, tokens_number) < 0)
+    {
+        goto error;
+    }
+
+release:
+    pack_args_release(args, tokens_number);
 cleanup:
-    sdsfreesplitres(tokens, tokens_number);
-    vk_free(lengths);
+    if (args != stack_args)
+    {
+        PyMem_Free(args);
+    }
     return result;
+
+error:
+    Py_CLEAR(result);
+    goto release;
 }
+
+/* Command whose constant arguments are encoded once. The encoding is split
+ * into `nvars + 1` parts around the variable arguments, part i ending at
+ * ends[i] in `encoded`. The first part starts with the command header. */
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t nvars;
+    PyObject *encoded;
+    Py_ssize_t *ends;
+} CommandTemplate;
+
+static void
+CommandTemplate_dealloc(CommandTemplate *self)
+{
+    PyTypeObject *type = Py_TYPE(self);
+
+    Py_XDECREF(self->encoded);
+    PyMem_Free(self->ends);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+static PyObject *
+CommandTemplate_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    pack_arg stack_args[PACK_STACK_ARGS];
+    pack_arg *cmd_args = stack_args;
+    PyObject **items = &PyTuple_GET_ITEM(args, 0);
+    CommandTemplate *self = NULL;
+    Py_ssize_t nargs = PyTuple_GET_SIZE(args);
+    Py_ssize_t nvars = 0, initialized = 0;
+
+    if (kwds != NULL && PyDict_GET_SIZE(kwds) > 0)
+    {
+        PyErr_SetString(PyExc_TypeError, "CommandTemplate() takes no keyword arguments");
+        return NULL;
+    }
+
+    if (nargs > PACK_STACK_ARGS)
+    {
+        cmd_args = PyMem_Malloc(sizeof(pack_arg) * nargs);
+        if (cmd_args == NULL)
+        {
+            return PyErr_NoMemory();
+        }
+    }
+
+    for (; initialized < nargs; initialized++)
+    {
+        pack_arg *arg = &cmd_args[initialized];
+
+        if (items[initialized] == Py_None)
+        {
+            arg->buf = NULL;
+            arg->len = 0;
+            arg->owner = NULL;
+            nvars++;
+        }
+        else if (pack_arg_init(arg, items[initialized]) < 0)
+        {
+            goto cleanup;
+        }
+    }
+
+    self = (CommandTemplate *)type->tp_alloc(type, 0);
+    if (self == NULL)
+    {
+        goto cleanup;
+    }
+    self->nvars = nvars;
+    self->encoded = NULL;
+    self->ends = PyMem_Malloc(sizeof(Py_ssize_t) * (nvars + 1));
+    if (self->ends == NULL)
+    {
+        PyErr_NoMemory();
+        Py_CLEAR(self);
+        goto cleanup;
+    }
+
+    /* The constant arguments are all there is to size, with the variable
+     * ones being empty. */
+    Py_ssize_t size = pack_command_size(cmd_args, nargs);
+    if (size != -1)
+    {
+        size -= nvars * (1 + 1 + 2 + 2);
+        self->encoded = PyBytes_FromStringAndSize(NULL, size);
+    }
+    if (self->encoded == NULL)
+    {
+        Py_CLEAR(self);
+        goto cleanup;
+    }
+
+    char *start = PyBytes_AS_STRING(self->encoded);
+    char *p = write_header(start, '*', nargs);
+    Py_ssize_t var = 0;
+    for (Py_ssize_t i = 0; i < nargs; i++)
+    {
+        if (items[i] == Py_None)
+        {
+            self->ends[var++] = p - start;
+            continue;
+        }
+        p = pack_command_write_arg(p, &cmd_args[i]);
+    }
+    self->ends[var] = p - start;
+
+cleanup:
+    pack_args_release(cmd_args, initialized);
+    if (cmd_args != stack_args)
+    {
+        PyMem_Free(cmd_args);
+    }
+    return (PyObject *)self;
+}
+
+/* Size of a command packed from the template with the given variable
+ * arguments, or -1 with an exception set when it doesn't fit. */
+static Py_ssize_t
+CommandTemplate_size(CommandTemplate *self, const pack_arg *vars)
+{
+    size_t size = PyBytes_GET_SIZE(self->encoded);
+
+    for (Py_ssize_t i = 0; i < self->nvars; i++)
+    {
+        size_t arg_size = 1 + count_digits(vars[i].len) + 2 + vars[i].len + 2;
+        if (arg_size > (size_t)PY_SSIZE_T_MAX - size)
+        {
+            PyErr_SetString(PyExc_OverflowError, "command is too large");
+            return -1;
+        }
+        size += arg_size;
+    }
+    return (Py_ssize_t)size;
+}
+
+static char *
+CommandTemplate_write(CommandTemplate *self, char *p, const pack_arg *vars)
+{
+    const char *encoded = PyBytes_AS_STRING(self->encoded);
+    Py_ssize_t start = 0;
+
+    for (Py_ssize_t i = 0; i <= self->nvars; i++)
+    {
+        memcpy(p, encoded + start, self->ends[i] - start);
+        p += self->ends[i] - start;
+        start = self->ends[i];
+        if (i < self->nvars)
+        {
+            p = pack_command_write_arg(p, &vars[i]);
+        }
+    }
+    return p;
+}
+
+/* Checks that a row of variable arguments fits the template. */
+static int
+CommandTemplate_check_vars(CommandTemplate *self, Py_ssize_t nvars)
+{
+    if (nvars != self->nvars)
+    {
+        PyErr_Format(PyExc_TypeError, "template takes %zd arguments (%zd given)",
+                     self->nvars, nvars);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *
+CommandTemplate_pack(CommandTemplate *self, PyObject *const *args, Py_ssize_t nvars)
+{
+    pack_arg stack_args[PACK_STACK_ARGS];
+    pack_arg *vars = stack_args;
+    PyObject *result = NULL;
+
+    if (CommandTemplate_check_vars(self, nvars) < 0)
+    {
+        return NULL;
+    }
+
+    if (nvars > PACK_STACK_ARGS)
+    {
+        vars = PyMem_Malloc(sizeof(pack_arg) * nvars);
+        if (vars == NULL)
+        {
+            return PyErr_NoMemory();
+        }
+    }
+
+    if (pack_args_init(vars, (PyObject **)args, nvars) < 0)
+    {
+        goto cleanup;
+    }
+
+    Py_ssize_t size = CommandTemplate_size(self, vars);
+    if (size != -1)
+    {
+        result = PyBytes_FromStringAndSize(NULL, size);
+        if (result != NULL)
+        {
+            CommandTemplate_write(self, PyBytes_AS_STRING(result), vars);
+        }
+    }
+
+    pack_args_release(vars, nvars);
+cleanup:
+    if (vars != stack_args)
+    {
+        PyMem_Free(vars);
+    }
+    return result;
+}
+
+static PyObject *
+CommandTemplate_pack_many_impl(CommandTemplate *self, PyObject *rows)
+{
+    PyObject *result = NULL;
+    pack_arg *vars = NULL;
+    Py_ssize_t initialized = 0;
+    Py_ssize_t size = 0;
+
+    PyObject *seq = PySequence_Fast(rows, "rows must be a sequence of tuples");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+
+    Py_ssize_t rows_number = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+
+    for (Py_ssize_t i = 0; i < rows_number; i++)
+    {
+        if (!PyTuple_Check(items[i]))
+        {
+            PyErr_SetString(PyExc_TypeError, "rows must be a sequence of tuples");
+            goto cleanup;
+        }
+        if (CommandTemplate_check_vars(self, PyTuple_GET_SIZE(items[i])) < 0)
+        {
+            goto cleanup;
+        }
+    }
+
+    Py_ssize_t vars_number = rows_number * self->nvars;
+    vars = PyMem_Malloc(sizeof(pack_arg) * (vars_number ? vars_number : 1));
+    if (vars == NULL)
+    {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+
+    for (Py_ssize_t i = 0; i < rows_number; i++)
+    {
+        if (pack_args_init(&vars[initialized], &PyTuple_GET_ITEM(items[i], 0), self->nvars) < 0)
+        {
+            goto cleanup;
+        }
+
+        Py_ssize_t row_size = CommandTemplate_size(self, &vars[initialized]);
+        initialized += self->nvars;
+        if (row_size == -1 || row_size > PY_SSIZE_T_MAX - size)
+        {
+            if (row_size != -1)
+            {
+                PyErr_SetString(PyExc_OverflowError, "pipeline is too large");
+            }
+            goto cleanup;
+        }
+        size += row_size;
+    }
+
+    result = PyBytes_FromStringAndSize(NULL, size);
+    if (result != NULL)
+    {
+        char *p = PyBytes_AS_STRING(result);
+        for (Py_ssize_t i = 0; i < rows_number; i++)
+        {
+            p = CommandTemplate_write(self, p, &vars[i * self->nvars]);
+        }
+    }
+
+cleanup:
+    pack_args_release(vars, initialized);
+    PyMem_Free(vars);
+    Py_DECREF(seq);
+    return result;
+}
+
+static PyObject *
+CommandTemplate_pack_many(CommandTemplate *self, PyObject *rows)
+{
+    PyObject *result;
+
+    /* Keep other threads from changing a list of rows while it is packed
+     * from its items. */
+    Py_BEGIN_CRITICAL_SECTION(rows);
+    result = CommandTemplate_pack_many_impl(self, rows);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+static PyMethodDef CommandTemplate_methods[] = {
+    {"pack", (PyCFunction)(void (*)(void))CommandTemplate_pack, METH_FASTCALL,
+     "pack(*args)\n\nPack the command with args in place of the variable arguments"},
+    {"pack_many", (PyCFunction)CommandTemplate_pack_many, METH_O,
+     "pack_many(rows)\n\nPack the command once for each tuple of args into a single bytes object"},
+    {NULL},
+};
+
+static PyType_Slot CommandTemplate_slots[] = {
+    {Py_tp_dealloc, (void *)CommandTemplate_dealloc},
+    {Py_tp_new, (void *)CommandTemplate_new},
+    {Py_tp_methods, CommandTemplate_methods},
+    {Py_tp_doc, (void *)"CommandTemplate(*args)\n\n"
+                        "Command with its constant arguments encoded once. None marks the\n"
+                        "variable arguments that are passed to pack() and pack_many()"},
+    {0, NULL},
+};
+
+PyType_Spec libvalkey_CommandTemplateSpec = {
+    MOD_LIBVALKEY ".CommandTemplate",
+    sizeof(CommandTemplate),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    CommandTemplate_slots,
+};
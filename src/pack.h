@@ -3,6 +3,17 @@
 
 #include <Python.h>
 
+/* Size from which pack_command_vectored references arguments instead of
+ * copying them. */
+#define PACK_VECTORED_THRESHOLD (16 * 1024)
+
 extern PyObject* pack_command(PyObject* cmd);
+extern PyObject* pack_command_slot(PyObject* cmd, Py_ssize_t key_index);
+extern PyObject* pack_into(PyObject* args);
+extern PyObject* pack_pipeline(PyObject* commands);
+extern PyObject* pack_pipeline_slots(PyObject* commands, Py_ssize_t key_index);
+extern PyObject* pack_command_vectored(PyObject* cmd, Py_ssize_t threshold);
+
+extern PyType_Spec libvalkey_CommandTemplateSpec;
 
 #endif
\ No newline at end of file
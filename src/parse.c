@@ -0,0 +1,615 @@
+#include "parse.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARSE_SSE2
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define PARSE_NEON
+#endif
+
+#if defined(PARSE_SSE2) || defined(PARSE_NEON)
+#define PARSE_SIMD
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/* Bytes that start a reply, apart from the '!' blob errors that only
+ * Parse_Frame accepts. */
+static const char parse_types[256] = {
+    ['+'] = 1, ['-'] = 1, [':'] = 1, [','] = 1, ['_'] = 1, ['#'] = 1, ['('] = 1,
+    ['$'] = 1, ['='] = 1, ['*'] = 1, ['~'] = 1, ['>'] = 1, ['%'] = 1, ['|'] = 1,
+};
+
+#define IS_TYPE(c) (parse_types[(unsigned char)(c)])
+
+/* Parses the decimal length between p and end. Returns 0 on success and -1
+ * when it isn't a valid number. */
+static int parse_length(const char *p, const char *end, long long *value) {
+    int negative = 0;
+    long long v = 0;
+
+    if (p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (p == end || end - p > 18)
+        return -1;
+
+    while (p < end) {
+        if (*p < '0' || *p > '9')
+            return -1;
+        v = v * 10 + (*p++ - '0');
+    }
+
+    *value = negative ? -v : v;
+    return 0;
+}
+
+/* Parses an integer the way the reader does, which rejects leading zeros,
+ * "-0" and values that don't fit in a long long. Returns 0 on success and
+ * -1 otherwise. */
+int Parse_Integer(const char *p, const char *end, long long *value) {
+    unsigned long long v = 0, limit;
+    int negative = 0;
+
+    if (end - p == 1 && *p == '0') {
+        *value = 0;
+        return 0;
+    }
+    if (p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (p == end || *p < '1' || *p > '9')
+        return -1;
+
+    /* Up to 18 digits can't overflow. */
+    if (end - p <= 18) {
+        for (; p < end; p++) {
+            if (*p < '0' || *p > '9')
+                return -1;
+            v = v * 10 + (*p - '0');
+        }
+        *value = negative ? -(long long)v : (long long)v;
+        return 0;
+    }
+
+    limit = negative ? (unsigned long long)LLONG_MAX + 1 : LLONG_MAX;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9' || v > (limit - (*p - '0')) / 10)
+            return -1;
+        v = v * 10 + (*p - '0');
+    }
+
+    *value = negative ? (long long)(0 - v) : (long long)v;
+    return 0;
+}
+
+static int equals_nocase(const char *p, size_t len, const char *word) {
+    size_t i;
+
+    if (strlen(word) != len)
+        return 0;
+    for (i = 0; i < len; i++)
+        if (tolower((unsigned char)p[i]) != word[i])
+            return 0;
+    return 1;
+}
+
+/* Parses a double the way the reader does. Returns 0 on success and -1
+ * otherwise. */
+int Parse_Double(const char *p, size_t len, double *value) {
+    char buf[326], *eptr;
+
+    if (len >= sizeof(buf))
+        return -1;
+
+    if (equals_nocase(p, len, "inf")) {
+        *value = INFINITY;
+    } else if (equals_nocase(p, len, "-inf")) {
+        *value = -INFINITY;
+    } else if (equals_nocase(p, len, "nan") || equals_nocase(p, len, "-nan")) {
+        *value = NAN;
+    } else {
+        memcpy(buf, p, len);
+        buf[len] = '\0';
+        *value = strtod(buf, &eptr);
+        if (len == 0 || eptr != &buf[len] || !isfinite(*value))
+            return -1;
+    }
+    return 0;
+}
+
+#ifdef PARSE_SIMD
+static int count_trailing_zeros(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(v);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long i;
+
+    _BitScanForward64(&i, v);
+    return (int)i;
+#else
+    int i = 0;
+
+    while ((v & 1) == 0) {
+        v >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* Returns a mask with a bit set for every '\r' in the 64 bytes at p, or in
+ * the bytes until end when there are fewer. */
+static uint64_t scan_block(const char *p, const char *end) {
+    uint64_t mask = 0;
+    size_t i, n;
+
+    if (end - p >= 64) {
+#ifdef PARSE_SSE2
+        const __m128i cr = _mm_set1_epi8('\r');
+
+        for (i = 0; i < 64; i += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)(p + i));
+            mask |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, cr)) << i;
+        }
+        return mask;
+#elif defined(PARSE_NEON)
+        static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+        const uint8x16_t cr = vdupq_n_u8('\r'), weights = vld1q_u8(bits);
+        const uint8_t *u = (const uint8_t *)p;
+        uint8x16_t t0, t1, t2, t3, sum;
+
+        t0 = vandq_u8(vceqq_u8(vld1q_u8(u), cr), weights);
+        t1 = vandq_u8(vceqq_u8(vld1q_u8(u + 16), cr), weights);
+        t2 = vandq_u8(vceqq_u8(vld1q_u8(u + 32), cr), weights);
+        t3 = vandq_u8(vceqq_u8(vld1q_u8(u + 48), cr), weights);
+        sum = vpaddq_u8(vpaddq_u8(t0, t1), vpaddq_u8(t2, t3));
+        sum = vpaddq_u8(sum, sum);
+        return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+#endif
+    }
+
+    n = (size_t)(end - p);
+    for (i = 0; i < n; i++)
+        mask |= (uint64_t)(p[i] == '\r') << i;
+    return mask;
+}
+#endif
+
+/* Finds line endings 64 bytes at a time with vector instructions. Replies
+ * of small elements have several lines in a block, which are then found
+ * without scanning again. Elsewhere memchr is used for every line. */
+typedef struct {
+    const char *block;
+    const char *end;
+    uint64_t mask;
+} parse_scanner;
+
+static void scanner_init(parse_scanner *scanner, const char *end) {
+    scanner->block = end;
+    scanner->end = end;
+    scanner->mask = 0;
+}
+
+/* Finds the CRLF that ends the line at p, or returns NULL when it isn't
+ * there yet. Lines must be looked up in the order of the data. */
+static const char *find_eol(parse_scanner *scanner, const char *p) {
+#ifdef PARSE_SIMD
+    uint64_t mask;
+
+    for (;;) {
+        if (p < scanner->block || p - scanner->block >= 64) {
+            if (p >= scanner->end)
+                return NULL;
+            scanner->block = p;
+            scanner->mask = scan_block(p, scanner->end);
+        }
+
+        mask = scanner->mask & (~(uint64_t)0 << (p - scanner->block));
+        if (mask == 0) {
+            if (scanner->end - scanner->block <= 64)
+                return NULL;
+            p = scanner->block + 64;
+            continue;
+        }
+
+        p = scanner->block + count_trailing_zeros(mask);
+        if (p + 1 >= scanner->end)
+            return NULL;
+        if (p[1] == '\n')
+            return p;
+        p++;
+    }
+#else
+    const char *eol = p;
+
+    do {
+        eol = memchr(eol, '\r', scanner->end - eol);
+        if (eol == NULL || eol + 1 >= scanner->end)
+            return NULL;
+    } while (eol[1] != '\n' && ++eol);
+    return eol;
+#endif
+}
+
+/* Finds the end of the reply at start without creating any objects.
+ * Returns PARSE_COMPLETE and stores the size of the reply in scanned when
+ * it is complete, PARSE_INCOMPLETE when more data is needed and PARSE_ERROR
+ * with a message in errstr on protocol errors. Scanning continues from
+ * scanned and pending, which should be 0 and 1 for a new reply. */
+int Parse_Frame(const char *start, const char *end, long long maxelements,
+                size_t *scanned, long long *pending, char *errstr, size_t errlen) {
+    size_t pos = *scanned;
+    long long left = *pending;
+    const char *p, *eol, *next;
+    parse_scanner scanner;
+    long long len;
+    int ret = PARSE_COMPLETE;
+
+    scanner_init(&scanner, end);
+    while (left > 0) {
+        p = start + pos;
+        if (p >= end) {
+            ret = PARSE_INCOMPLETE;
+            break;
+        }
+
+        /* Like the reader, reject an unknown type before its line is complete. */
+        if (!IS_TYPE(*p) && *p != '!')
+            goto bad_type;
+
+        eol = find_eol(&scanner, p);
+        if (eol == NULL) {
+            ret = PARSE_INCOMPLETE;
+            break;
+        }
+        next = eol + 2;
+
+        switch (*p) {
+            case '$':
+            case '!':
+            case '=':
+                if (parse_length(p + 1, eol, &len) < 0) {
+                    PyOS_snprintf(errstr, errlen, "Bad bulk string length");
+                    return PARSE_ERROR;
+                }
+                if (len < -1) {
+                    PyOS_snprintf(errstr, errlen, "Bulk string length out of range");
+                    return PARSE_ERROR;
+                }
+                if (len >= 0) {
+                    if ((size_t)(end - next) < (size_t)len + 2) {
+                        ret = PARSE_INCOMPLETE;
+                        goto done;
+                    }
+                    next += len + 2;
+                }
+                left--;
+                break;
+            case '*':
+            case '~':
+            case '>':
+            case '%':
+            case '|':
+                if (parse_length(p + 1, eol, &len) < 0) {
+                    PyOS_snprintf(errstr, errlen, "Bad multi-bulk length");
+                    return PARSE_ERROR;
+                }
+                if (len < -1 || (maxelements > 0 && len > maxelements)) {
+                    PyOS_snprintf(errstr, errlen, "Multi-bulk length out of range");
+                    return PARSE_ERROR;
+                }
+                left--;
+                if (len > 0)
+                    left += (*p == '%' || *p == '|') ? len * 2 : len;
+                break;
+            default:
+                left--;
+        }
+        pos = next - start;
+    }
+
+done:
+    *scanned = pos;
+    *pending = left;
+    return ret;
+
+bad_type:
+    PyOS_snprintf(errstr, errlen,
+                  isprint((unsigned char)*p) ?
+                      "Protocol error, got \"%c\" as reply type byte" :
+                      "Protocol error, got \"\\x%02x\" as reply type byte",
+                  (unsigned char)*p);
+    return PARSE_ERROR;
+}
+
+static libvalkey_ParseNode *add_node(libvalkey_Parser *parser, int type) {
+    libvalkey_ParseNode *nodes, *node;
+    size_t cap;
+
+    if (parser->count == parser->cap) {
+        cap = parser->cap > 0 ? parser->cap * 2 : 64;
+        nodes = PyMem_RawRealloc(parser->nodes, cap * sizeof(*nodes));
+        if (nodes == NULL)
+            return NULL;
+        parser->nodes = nodes;
+        parser->cap = cap;
+    }
+
+    node = &parser->nodes[parser->count++];
+    node->type = type;
+    node->value.elements = 0;
+    return node;
+}
+
+static int open_aggregate(libvalkey_Parser *parser, long long elements) {
+    long long *levels;
+    size_t cap;
+
+    if (parser->level + 1 >= parser->levelsCap) {
+        cap = parser->levelsCap > 0 ? parser->levelsCap * 2 : 8;
+        levels = PyMem_RawRealloc(parser->levels, cap * sizeof(*levels));
+        if (levels == NULL)
+            return -1;
+        parser->levels = levels;
+        parser->levelsCap = cap;
+    }
+
+    parser->levels[++parser->level] = elements;
+    if (parser->level > parser->depth)
+        parser->depth = parser->level;
+    return 0;
+}
+
+/* Splits the reply at start into nodes, continuing where the last call
+ * stopped. Returns PARSE_COMPLETE when the reply is complete, after which
+ * pos is its size, and PARSE_INCOMPLETE when more data is needed. With a
+ * limit, PARSE_LIMIT is returned once at least that many bytes were
+ * tokenized. PARSE_ERROR is returned when the reply can't be parsed or
+ * memory ran out, which is left for the reader to report. Only uses the raw
+ * allocator, so it can run without the GIL. */
+int Parse_Tokenize(libvalkey_Parser *parser, const char *start, const char *end,
+                   long long maxelements, size_t limit) {
+    libvalkey_ParseNode *node;
+    const char *p, *s, *eol, *next;
+    parse_scanner scanner;
+    long long len;
+    int type;
+
+    scanner_init(&scanner, end);
+    for (;;) {
+        if (limit > 0 && parser->pos >= limit)
+            return PARSE_LIMIT;
+
+        p = start + parser->pos;
+        if (p >= end)
+            return PARSE_INCOMPLETE;
+        if ((eol = find_eol(&scanner, p)) == NULL) {
+            /* Like the reader, reject an unknown type before its line is
+             * complete. */
+            if (!IS_TYPE(*p))
+                return PARSE_ERROR;
+            return PARSE_INCOMPLETE;
+        }
+        s = p + 1;
+        next = eol + 2;
+
+        switch (*p) {
+            case '+':
+            case '-':
+                type = *p == '+' ? VALKEY_REPLY_STATUS : VALKEY_REPLY_ERROR;
+                if (memchr(s, '\r', eol - s) != NULL || memchr(s, '\n', eol - s) != NULL ||
+                    (node = add_node(parser, type)) == NULL)
+                    return PARSE_ERROR;
+                node->offset = s - start;
+                node->len = eol - s;
+                break;
+            case ':':
+                if ((node = add_node(parser, VALKEY_REPLY_INTEGER)) == NULL ||
+                    Parse_Integer(s, eol, &node->value.integer) < 0)
+                    return PARSE_ERROR;
+                break;
+            case ',':
+                if ((node = add_node(parser, VALKEY_REPLY_DOUBLE)) == NULL ||
+                    Parse_Double(s, eol - s, &node->value.dbl) < 0)
+                    return PARSE_ERROR;
+                node->offset = s - start;
+                node->len = eol - s;
+                break;
+            case '_':
+                if (eol != s || add_node(parser, VALKEY_REPLY_NIL) == NULL)
+                    return PARSE_ERROR;
+                break;
+            case '#':
+                if (eol - s != 1 || strchr("tTfF", *s) == NULL || *s == '\0' ||
+                    (node = add_node(parser, VALKEY_REPLY_BOOL)) == NULL)
+                    return PARSE_ERROR;
+                node->value.integer = *s == 't' || *s == 'T';
+                break;
+            case '(':
+                for (len = 0; len < eol - s; len++)
+                    if ((s[len] < '0' || s[len] > '9') && (len > 0 || s[len] != '-'))
+                        return PARSE_ERROR;
+                if ((node = add_node(parser, VALKEY_REPLY_BIGNUM)) == NULL)
+                    return PARSE_ERROR;
+                node->offset = s - start;
+                node->len = eol - s;
+                break;
+            case '$':
+            case '=':
+                type = *p == '$' ? VALKEY_REPLY_STRING : VALKEY_REPLY_VERB;
+                if (Parse_Integer(s, eol, &len) < 0 || len < -1)
+                    return PARSE_ERROR;
+                if (len == -1) {
+                    if (add_node(parser, VALKEY_REPLY_NIL) == NULL)
+                        return PARSE_ERROR;
+                    break;
+                }
+                if ((size_t)(end - next) < (size_t)len + 2)
+                    return PARSE_INCOMPLETE;
+                if ((type == VALKEY_REPLY_VERB && (len < 4 || next[3] != ':')) ||
+                    (node = add_node(parser, type)) == NULL)
+                    return PARSE_ERROR;
+                node->offset = next - start;
+                node->len = len;
+                next += len + 2;
+                break;
+            case '*':
+            case '~':
+            case '>':
+            case '%':
+            case '|':
+                type = *p == '*' ? VALKEY_REPLY_ARRAY :
+                       *p == '~' ? VALKEY_REPLY_SET :
+                       *p == '>' ? VALKEY_REPLY_PUSH :
+                       *p == '%' ? VALKEY_REPLY_MAP : VALKEY_REPLY_ATTR;
+                if (Parse_Integer(s, eol, &len) < 0 || len < -1 ||
+                    (maxelements > 0 && len > maxelements))
+                    return PARSE_ERROR;
+                if (len == -1) {
+                    if (add_node(parser, VALKEY_REPLY_NIL) == NULL)
+                        return PARSE_ERROR;
+                    break;
+                }
+                if (type == VALKEY_REPLY_MAP || type == VALKEY_REPLY_ATTR)
+                    len *= 2;
+                if ((node = add_node(parser, type)) == NULL)
+                    return PARSE_ERROR;
+                node->value.elements = len;
+                if (len > 0) {
+                    if (open_aggregate(parser, len) < 0)
+                        return PARSE_ERROR;
+                    parser->pos = next - start;
+                    continue;
+                }
+                break;
+            default:
+                return PARSE_ERROR;
+        }
+        parser->pos = next - start;
+
+        /* The element is complete, and so are the aggregates it ends. */
+        while (parser->level > 0 && --parser->levels[parser->level] == 0)
+            parser->level--;
+        if (parser->level == 0)
+            return PARSE_COMPLETE;
+    }
+}
+
+/* Frees the nodes and gets the parser ready for the next reply. */
+void Parse_Reset(libvalkey_Parser *parser) {
+    PyMem_RawFree(parser->nodes);
+    PyMem_RawFree(parser->levels);
+    memset(parser, 0, sizeof(*parser));
+}
+
+static int is_aggregate(int type) {
+    return type == VALKEY_REPLY_ARRAY || type == VALKEY_REPLY_SET ||
+           type == VALKEY_REPLY_PUSH || type == VALKEY_REPLY_MAP ||
+           type == VALKEY_REPLY_ATTR;
+}
+
+/* Creates the objects of a tokenized reply with the reader's callbacks,
+ * passing them the same tasks the reader would. start is the data the
+ * reply was tokenized from. When column is given, it gets the first chance
+ * to create aggregates without nested aggregates. Returns the reply, or
+ * NULL when a callback failed. */
+void *Parse_Build(const libvalkey_Parser *parser, char *start,
+                  valkeyReplyObjectFunctions *fn, Parse_ColumnFunc column, void *privdata) {
+    const libvalkey_ParseNode *node;
+    valkeyReadTask *tasks, *task;
+    void *root = NULL, *obj;
+    size_t i, j, level = 0;
+    int ret;
+
+    tasks = PyMem_Malloc((parser->depth + 1) * sizeof(*tasks));
+    if (tasks == NULL)
+        return NULL;
+    tasks[0].idx = -1;
+
+    for (i = 0; i < parser->count; i++) {
+        node = &parser->nodes[i];
+        task = &tasks[level];
+        task->type = node->type;
+        task->elements = 0;
+        task->obj = NULL;
+        task->parent = level > 0 ? &tasks[level - 1] : NULL;
+        task->privdata = privdata;
+
+        switch (node->type) {
+            case VALKEY_REPLY_ARRAY:
+            case VALKEY_REPLY_SET:
+            case VALKEY_REPLY_PUSH:
+            case VALKEY_REPLY_MAP:
+            case VALKEY_REPLY_ATTR:
+                task->elements = node->value.elements;
+                /* Empty aggregates have no type of elements, and are
+                 * always created as usual. */
+                if (column != NULL && task->elements > 0) {
+                    for (j = 1; j <= (size_t)task->elements; j++)
+                        if (is_aggregate(node[j].type))
+                            break;
+                    if (j > (size_t)task->elements) {
+                        ret = column(task, node + 1, j - 1, start, &obj);
+                        if (ret < 0)
+                            goto error;
+                        if (ret > 0) {
+                            /* The elements were created with it. */
+                            task->elements = 0;
+                            i += j - 1;
+                            break;
+                        }
+                    }
+                }
+                obj = fn->createArray(task, task->elements);
+                break;
+            case VALKEY_REPLY_INTEGER:
+                obj = fn->createInteger(task, node->value.integer);
+                break;
+            case VALKEY_REPLY_DOUBLE:
+                obj = fn->createDouble(task, node->value.dbl, start + node->offset, node->len);
+                break;
+            case VALKEY_REPLY_NIL:
+                obj = fn->createNil(task);
+                break;
+            case VALKEY_REPLY_BOOL:
+                obj = fn->createBool(task, (int)node->value.integer);
+                break;
+            default:
+                obj = fn->createString(task, start + node->offset, node->len);
+        }
+        if (obj == NULL)
+            goto error;
+        if (level == 0)
+            root = obj;
+
+        if (task->elements > 0) {
+            task->obj = obj;
+            tasks[++level].idx = 0;
+            continue;
+        }
+        while (level > 0 && ++tasks[level].idx == tasks[level - 1].elements)
+            level--;
+    }
+
+    PyMem_Free(tasks);
+    return root;
+
+error:
+    if (root != NULL)
+        fn->freeObject(root);
+    PyMem_Free(tasks);
+    return NULL;
+}
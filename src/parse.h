@@ -0,0 +1,60 @@
+#ifndef __PARSE_H
+#define __PARSE_H
+
+#include <Python.h>
+#include <valkey/read.h>
+
+/* Results of Parse_Frame and Parse_Tokenize. */
+enum {
+    PARSE_ERROR = -1,
+    PARSE_INCOMPLETE = 0,
+    PARSE_COMPLETE = 1,
+    PARSE_LIMIT = 2,
+};
+
+/* Element of a reply, in the order the reader would create it. */
+typedef struct {
+    int type;           /* VALKEY_REPLY_* */
+    size_t offset;      /* strings and doubles: data relative to the reply */
+    size_t len;
+    union {
+        long long elements; /* aggregates, with keys and values counted for maps */
+        long long integer;  /* integers and booleans */
+        double dbl;
+    } value;
+} libvalkey_ParseNode;
+
+/* Tokenizer state, which is kept while a reply is incomplete so data is
+ * only tokenized once no matter how it arrives. */
+typedef struct {
+    libvalkey_ParseNode *nodes;
+    size_t count;
+    size_t cap;
+    size_t depth;       /* deepest nesting of aggregates */
+    long long *levels;  /* elements still missing from open aggregates */
+    size_t level;
+    size_t levelsCap;
+    size_t pos;         /* bytes of the reply tokenized so far */
+} libvalkey_Parser;
+
+/* Creates an aggregate whose elements are all scalars from its nodes at
+ * once. Returns 1 and stores the object, 0 when the elements should be
+ * created one by one and -1 on errors. */
+typedef int (*Parse_ColumnFunc)(const valkeyReadTask *task, const libvalkey_ParseNode *nodes,
+                                size_t count, char *start, void **obj);
+
+/* Parse_Frame and Parse_Tokenize don't use the Python API and can run
+ * without the GIL. Parse_Frame only finds the end of a reply, while
+ * Parse_Tokenize splits it into nodes that Parse_Build creates the
+ * objects from. */
+int Parse_Frame(const char *start, const char *end, long long maxelements,
+                size_t *scanned, long long *pending, char *errstr, size_t errlen);
+int Parse_Tokenize(libvalkey_Parser *parser, const char *start, const char *end,
+                   long long maxelements, size_t limit);
+void Parse_Reset(libvalkey_Parser *parser);
+void *Parse_Build(const libvalkey_Parser *parser, char *start,
+                  valkeyReplyObjectFunctions *fn, Parse_ColumnFunc column, void *privdata);
+int Parse_Integer(const char *p, const char *end, long long *value);
+int Parse_Double(const char *p, size_t len, double *value);
+
+#endif
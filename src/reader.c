@@ -1,100 +1,370 @@
 #include "reader.h"
 #include "libvalkey.h"
+#include "lazy.h"
+#include "intern.h"
+#include "decode.h"
+#include "parse.h"
+#include "streamed.h"
+#include "sds.h"
 
 #include <assert.h>
+#include <limits.h>
+
+/* Free space reserved by #get_buffer when no size hint is given. Growing an
+ * empty buffer by this much keeps it within the default maxbuf. */
+#define READER_BUFFER_SIZE (VALKEY_READER_MAX_BUF / 2)
+
+/* Size from which bulk strings are streamed when a handler is set. */
+#define READER_STREAM_THRESHOLD (1024 * 1024)
 
 static void Reader_dealloc(libvalkey_ReaderObject *self);
 static int Reader_traverse(libvalkey_ReaderObject *self, visitproc visit, void *arg);
+static int Reader_clear(libvalkey_ReaderObject *self);
 static int Reader_init(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds);
 static PyObject *Reader_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
 static PyObject *Reader_feed(libvalkey_ReaderObject *self, PyObject *args);
-static PyObject *Reader_gets(libvalkey_ReaderObject *self, PyObject *args);
+static PyObject *Reader_gets(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds);
+static PyObject *Reader_gets_many(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds);
+static PyObject *Reader_gets_raw(libvalkey_ReaderObject *self, PyObject *unused);
+static PyObject *Reader_gets_ints(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds);
+static PyObject *Reader_expect_ok(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds);
+static PyObject *Reader_get_buffer(libvalkey_ReaderObject *self, PyObject *args);
+static PyObject *Reader_commit(libvalkey_ReaderObject *self, PyObject *arg);
+static PyObject *Reader_resolve(libvalkey_ReaderObject *self, PyObject *args);
+static int Reader_getbuffer(libvalkey_ReaderObject *self, Py_buffer *view, int flags);
+static void Reader_releasebuffer(libvalkey_ReaderObject *self, Py_buffer *view);
 static PyObject *Reader_setmaxbuf(libvalkey_ReaderObject *self, PyObject *arg);
-static PyObject *Reader_getmaxbuf(libvalkey_ReaderObject *self);
-static PyObject *Reader_len(libvalkey_ReaderObject *self);
-static PyObject *Reader_has_data(libvalkey_ReaderObject *self);
+static PyObject *Reader_getmaxbuf(libvalkey_ReaderObject *self, PyObject *unused);
+static PyObject *Reader_len(libvalkey_ReaderObject *self, PyObject *unused);
+static PyObject *Reader_has_data(libvalkey_ReaderObject *self, PyObject *unused);
 static PyObject *Reader_set_encoding(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds);
+static PyObject *Reader_set_push_handler(libvalkey_ReaderObject *self, PyObject *arg);
+static PyObject *Reader_set_stream_handler(libvalkey_ReaderObject *self, PyObject *arg);
+static PyObject *Reader_reset(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds);
+static PyObject *Reader_stats(libvalkey_ReaderObject *self, PyObject *unused);
+static PyObject *Reader_reset_stats(libvalkey_ReaderObject *self, PyObject *unused);
 static PyObject *Reader_convertSetsToLists(PyObject *self, void *closure);
+static PyObject *Reader_pushHandler(PyObject *self, void *closure);
+
+/* While the GIL is released to parse a large reply, other threads must not
+ * touch the buffer it is parsed from. */
+static int _Reader_check_busy(libvalkey_ReaderObject *self) {
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Reader is being used by another thread");
+        return -1;
+    }
+    return 0;
+}
+
+/* Defines method##_locked, which runs method in a critical section on the
+ * reader. On free-threaded builds this makes sure that a reader is only
+ * used by one thread at a time, with the GIL it does nothing. Methods fail
+ * while another thread parses with the GIL released. */
+#define READER_LOCKED(method) \
+    static PyObject *method##_locked(libvalkey_ReaderObject *self, PyObject *args) { \
+        PyObject *result; \
+        Py_BEGIN_CRITICAL_SECTION(self); \
+        result = _Reader_check_busy(self) < 0 ? NULL : method(self, args); \
+        Py_END_CRITICAL_SECTION(); \
+        return result; \
+    }
+
+#define READER_LOCKED_KW(method) \
+    static PyObject *method##_locked(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) { \
+        PyObject *result; \
+        Py_BEGIN_CRITICAL_SECTION(self); \
+        result = _Reader_check_busy(self) < 0 ? NULL : method(self, args, kwds); \
+        Py_END_CRITICAL_SECTION(); \
+        return result; \
+    }
+
+READER_LOCKED(Reader_feed)
+READER_LOCKED_KW(Reader_gets)
+READER_LOCKED_KW(Reader_gets_many)
+READER_LOCKED(Reader_gets_raw)
+READER_LOCKED_KW(Reader_gets_ints)
+READER_LOCKED_KW(Reader_expect_ok)
+READER_LOCKED(Reader_get_buffer)
+READER_LOCKED(Reader_commit)
+READER_LOCKED(Reader_resolve)
+READER_LOCKED(Reader_setmaxbuf)
+READER_LOCKED(Reader_getmaxbuf)
+READER_LOCKED(Reader_len)
+READER_LOCKED(Reader_has_data)
+READER_LOCKED_KW(Reader_set_encoding)
+READER_LOCKED(Reader_set_push_handler)
+READER_LOCKED(Reader_set_stream_handler)
+READER_LOCKED_KW(Reader_reset)
+READER_LOCKED(Reader_stats)
+READER_LOCKED(Reader_reset_stats)
 
 static PyMethodDef libvalkey_ReaderMethods[] = {
-    {"feed", (PyCFunction)Reader_feed, METH_VARARGS, NULL },
-    {"gets", (PyCFunction)Reader_gets, METH_VARARGS, NULL },
-    {"setmaxbuf", (PyCFunction)Reader_setmaxbuf, METH_O, NULL },
-    {"getmaxbuf", (PyCFunction)Reader_getmaxbuf, METH_NOARGS, NULL },
-    {"len", (PyCFunction)Reader_len, METH_NOARGS, NULL },
-    {"has_data", (PyCFunction)Reader_has_data, METH_NOARGS, NULL },
-    {"set_encoding", (PyCFunction)Reader_set_encoding, METH_VARARGS | METH_KEYWORDS, NULL },
+    {"feed", (PyCFunction)Reader_feed_locked, METH_VARARGS, NULL },
+    {"gets", (PyCFunction)Reader_gets_locked, METH_VARARGS | METH_KEYWORDS, NULL },
+    {"gets_many", (PyCFunction)Reader_gets_many_locked, METH_VARARGS | METH_KEYWORDS, NULL },
+    {"gets_raw", (PyCFunction)Reader_gets_raw_locked, METH_NOARGS, NULL },
+    {"gets_ints", (PyCFunction)Reader_gets_ints_locked, METH_VARARGS | METH_KEYWORDS, NULL },
+    {"expect_ok", (PyCFunction)Reader_expect_ok_locked, METH_VARARGS | METH_KEYWORDS, NULL },
+    {"get_buffer", (PyCFunction)Reader_get_buffer_locked, METH_VARARGS, NULL },
+    {"commit", (PyCFunction)Reader_commit_locked, METH_O, NULL },
+    {"resolve", (PyCFunction)Reader_resolve_locked, METH_VARARGS, NULL },
+    {"setmaxbuf", (PyCFunction)Reader_setmaxbuf_locked, METH_O, NULL },
+    {"getmaxbuf", (PyCFunction)Reader_getmaxbuf_locked, METH_NOARGS, NULL },
+    {"len", (PyCFunction)Reader_len_locked, METH_NOARGS, NULL },
+    {"has_data", (PyCFunction)Reader_has_data_locked, METH_NOARGS, NULL },
+    {"set_encoding", (PyCFunction)Reader_set_encoding_locked, METH_VARARGS | METH_KEYWORDS, NULL },
+    {"set_push_handler", (PyCFunction)Reader_set_push_handler_locked, METH_O, NULL },
+    {"set_stream_handler", (PyCFunction)Reader_set_stream_handler_locked, METH_O, NULL },
+    {"reset", (PyCFunction)Reader_reset_locked, METH_VARARGS | METH_KEYWORDS, NULL },
+    {"stats", (PyCFunction)Reader_stats_locked, METH_NOARGS, NULL },
+    {"reset_stats", (PyCFunction)Reader_reset_stats_locked, METH_NOARGS, NULL },
     { NULL }  /* Sentinel */
 };
 
 static PyGetSetDef libvalkey_ReaderGetSet[] = {
     {"convertSetsToLists", (getter)Reader_convertSetsToLists, NULL, NULL, NULL},
+    {"pushHandler", (getter)Reader_pushHandler, NULL, NULL, NULL},
     {NULL}  /* Sentinel */
 };
 
-PyTypeObject libvalkey_ReaderType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    MOD_LIBVALKEY ".Reader",        /*tp_name*/
-    sizeof(libvalkey_ReaderObject), /*tp_basicsize*/
-    0,                            /*tp_itemsize*/
-    (destructor)Reader_dealloc,   /*tp_dealloc*/
-    0,                            /*tp_print*/
-    0,                            /*tp_getattr*/
-    0,                            /*tp_setattr*/
-    0,                            /*tp_compare*/
-    0,                            /*tp_repr*/
-    0,                            /*tp_as_number*/
-    0,                            /*tp_as_sequence*/
-    0,                            /*tp_as_mapping*/
-    0,                            /*tp_hash */
-    0,                            /*tp_call*/
-    0,                            /*tp_str*/
-    0,                            /*tp_getattro*/
-    0,                            /*tp_setattro*/
-    0,                            /*tp_as_buffer*/
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC, /*tp_flags*/
-    "Valkey protocol reader",    /*tp_doc */
-    (traverseproc)Reader_traverse,/*tp_traverse */
-    0,                            /*tp_clear */
-    0,                            /*tp_richcompare */
-    0,                            /*tp_weaklistoffset */
-    0,                            /*tp_iter */
-    0,                            /*tp_iternext */
-    libvalkey_ReaderMethods,        /*tp_methods */
-    0,                            /*tp_members */
-    libvalkey_ReaderGetSet,        /*tp_getset */
-    0,                            /*tp_base */
-    0,                            /*tp_dict */
-    0,                            /*tp_descr_get */
-    0,                            /*tp_descr_set */
-    0,                            /*tp_dictoffset */
-    (initproc)Reader_init,        /*tp_init */
-    0,                            /*tp_alloc */
-    Reader_new,                   /*tp_new */
+static PyType_Slot libvalkey_ReaderSlots[] = {
+    {Py_tp_dealloc, (void *)Reader_dealloc},
+    {Py_tp_traverse, (void *)Reader_traverse},
+    {Py_tp_clear, (void *)Reader_clear},
+    {Py_tp_doc, (void *)"Valkey protocol reader"},
+    {Py_tp_methods, libvalkey_ReaderMethods},
+    {Py_tp_getset, libvalkey_ReaderGetSet},
+    {Py_tp_init, (void *)Reader_init},
+    {Py_tp_new, (void *)Reader_new},
+    {Py_bf_getbuffer, (void *)Reader_getbuffer},
+    {Py_bf_releasebuffer, (void *)Reader_releasebuffer},
+    {0, NULL},
+};
+
+PyType_Spec libvalkey_ReaderSpec = {
+    MOD_LIBVALKEY ".Reader",
+    sizeof(libvalkey_ReaderObject),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    libvalkey_ReaderSlots,
 };
 
+#if PY_VERSION_HEX < 0x030A0000 || defined(PYPY_VERSION)
+/* Calls a function of the gc module that takes no arguments, keeping any
+ * exception that is set. Returns its truth value. */
+static int _Reader_call_gc(PyObject *func) {
+    PyObject *type, *value, *traceback, *result;
+    int ret = 0;
+
+    PyErr_Fetch(&type, &value, &traceback);
+    result = PyObject_CallObject(func, NULL);
+    if (result != NULL)
+        ret = PyObject_IsTrue(result) == 1;
+    else
+        PyErr_WriteUnraisable(NULL);
+    Py_XDECREF(result);
+    PyErr_Restore(type, value, traceback);
+    return ret;
+}
+#endif
+
+#ifdef Py_GIL_DISABLED
+#define GC_LOCK(state) PyMutex_Lock(&(state)->gcMutex)
+#define GC_UNLOCK(state) PyMutex_Unlock(&(state)->gcMutex)
+#else
+#define GC_LOCK(state)
+#define GC_UNLOCK(state)
+#endif
+
+/* Adds the reader to the readers that pause automatic garbage collection.
+ * The first one disables it, unless it is disabled already. Returns whether
+ * collection is paused by the readers. */
+static int _Reader_enter_gc_pause(libvalkey_ReaderObject *self) {
+    struct libvalkey_ModuleState *state = self->state;
+    int paused;
+
+    self->gcPaused = 1;
+    GC_LOCK(state);
+    if (state->gcPauses++ == 0) {
+#if PY_VERSION_HEX >= 0x030A0000 && !defined(PYPY_VERSION)
+        state->gcWasEnabled = PyGC_Disable();
+#else
+        state->gcWasEnabled = _Reader_call_gc(state->GcIsEnabled);
+        if (state->gcWasEnabled)
+            _Reader_call_gc(state->GcDisable);
+#endif
+    }
+    paused = state->gcWasEnabled;
+    GC_UNLOCK(state);
+    return paused;
+}
+
+/* Pauses automatic garbage collection while the reader reads a large
+ * reply. The pause is shared by all readers, so that a reader can't resume
+ * collection while another one still relies on it being paused. */
+static void _Reader_pause_gc(libvalkey_ReaderObject *self) {
+    if (self->gcPaused)
+        return;
+    if (_Reader_enter_gc_pause(self) && self->stats != NULL)
+        self->stats->gcPauses++;
+}
+
+/* Ends the pause of the reader. The last reader to end it enables
+ * collection again, but only when it was enabled before the pause. */
+static void _Reader_resume_gc(libvalkey_ReaderObject *self) {
+    struct libvalkey_ModuleState *state = self->state;
+
+    if (!self->gcPaused)
+        return;
+    self->gcPaused = 0;
+
+    GC_LOCK(state);
+    if (--state->gcPauses == 0 && state->gcWasEnabled) {
+        state->gcWasEnabled = 0;
+#if PY_VERSION_HEX >= 0x030A0000 && !defined(PYPY_VERSION)
+        PyGC_Enable();
+#else
+        _Reader_call_gc(state->GcEnable);
+#endif
+    }
+    GC_UNLOCK(state);
+}
+
+/* Ends the pause of the reader before Python code that the reader was
+ * given is called while a reply is read, such as the replyError callable
+ * or a codec. The code then sees the state of garbage collection that it
+ * expects and can change it. Returns whether to pause again afterwards. */
+static int _Reader_begin_callback(libvalkey_ReaderObject *self) {
+    if (!self->gcPaused)
+        return 0;
+    _Reader_resume_gc(self);
+    return 1;
+}
+
+/* Pauses collection again after the code was called. When the code
+ * disabled collection, it stays disabled after the reply was read. */
+static void _Reader_end_callback(libvalkey_ReaderObject *self, int paused) {
+    if (paused)
+        _Reader_enter_gc_pause(self);
+}
+
+/* Whether the element of task is a key or value of a reply that is created
+ * by a ReplyTransform. */
+static int transformParent(const valkeyReadTask *task) {
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
+    return self->replyTransform != NULL && task->parent != NULL && task->parent->parent == NULL;
+}
+
+/* Returns the lazy aggregate the element of task goes into, or NULL when
+ * the element has to be created as a Python object right away. */
+static PyObject *lazyParent(const valkeyReadTask *task) {
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
+    if (self->lazy && task->parent && !transformParent(task))
+        return (PyObject*)task->parent->obj;
+    return NULL;
+}
+
+/* Whether obj is tracked by the garbage collector. Replies are trees, so
+ * containers only need to be tracked once they hold such an object. */
+static int isTracked(PyObject *obj) {
+    return PyObject_IS_GC(obj) && PyObject_GC_IsTracked(obj);
+}
+
+/* Tracks the aggregates the element of task is in after a tracked object
+ * was added to it. Maps track themselves, so all of them are checked. */
+static void trackParents(const valkeyReadTask *task) {
+    const valkeyReadTask *parent;
+
+    for (parent = task->parent; parent != NULL; parent = parent->parent)
+        if (!PyObject_GC_IsTracked((PyObject*)parent->obj))
+            PyObject_GC_Track((PyObject*)parent->obj);
+}
+
+/* Adds the key or value obj to the dict parent. Keys are kept until their
+ * value arrives. */
+static void *setMapItem(libvalkey_ReaderObject *self, PyObject *parent, int idx, PyObject *obj) {
+    int x;
+
+    if (idx % 2 == 0) {
+        /* Save the object as a key. */
+        self->pendingObject = obj;
+        return obj;
+    }
+    if (self->pendingObject == NULL) {
+        Py_DECREF(obj);
+        return NULL;
+    }
+    x = PyDict_SetItem(parent, self->pendingObject, obj);
+    Py_DECREF(obj);
+    Py_DECREF(self->pendingObject);
+    self->pendingObject = NULL;
+    if (x < 0) {
+        return NULL;
+    }
+    return obj;
+}
+
+/* Adds obj to the reply created by the reader's ReplyTransform. */
+static void *setTransformItem(libvalkey_ReaderObject *self, PyObject *parent, int idx,
+                              PyObject *obj) {
+    libvalkey_TransformObject *transform = (libvalkey_TransformObject*)self->replyTransform;
+    PyObject *pair, *old;
+
+    switch (transform->kind) {
+        case TRANSFORM_DICT:
+            return setMapItem(self, parent, idx, obj);
+        case TRANSFORM_PAIRS:
+            if (idx % 2 == 0) {
+                self->pendingObject = obj;
+                return obj;
+            }
+            pair = PyTuple_New(2);
+            if (pair == NULL) {
+                Py_DECREF(obj);
+                return NULL;
+            }
+            PyTuple_SET_ITEM(pair, 0, self->pendingObject);
+            PyTuple_SET_ITEM(pair, 1, obj);
+            self->pendingObject = NULL;
+            PyList_SET_ITEM(parent, idx / 2, pair);
+            if (!isTracked(PyTuple_GET_ITEM(pair, 0)) && !isTracked(obj))
+                PyObject_GC_UnTrack(pair);
+            else if (!PyObject_GC_IsTracked(parent))
+                PyObject_GC_Track(parent);
+            return obj;
+        default:
+            if (idx % 2 == 1 && self->transformField >= 0) {
+                old = PyTuple_GET_ITEM(parent, self->transformField);
+                PyTuple_SET_ITEM(parent, self->transformField, obj);
+                Py_DECREF(old);
+                if (isTracked(obj) && !PyObject_GC_IsTracked(parent))
+                    PyObject_GC_Track(parent);
+            } else {
+                /* Keys that weren't strings, and values of unknown fields.
+                 * Aggregates stay alive while their elements are read. */
+                if (idx % 2 == 0)
+                    self->transformField = -1;
+                Py_XSETREF(self->transformDiscard, obj);
+            }
+            return obj;
+    }
+}
+
 static void *tryParentize(const valkeyReadTask *task, PyObject *obj) {
     libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
     if (task && task->parent) {
         PyObject *parent = (PyObject*)task->parent->obj;
+        if (transformParent(task))
+            return setTransformItem(self, parent, task->idx, obj);
+        if (self->lazy) {
+            if (Lazy_AppendObject(parent, obj) < 0)
+                return NULL;
+            return obj;
+        }
         switch (task->parent->type) {
             case VALKEY_REPLY_MAP:
-                if (task->idx % 2 == 0) {
-                    /* Save the object as a key. */
-                    self->pendingObject = obj;
-                } else {
-                    if (self->pendingObject == NULL) {
-                        Py_DECREF(obj);
-                        return NULL;
-                    }
-                    int x = PyDict_SetItem(parent, self->pendingObject, obj);
-                    Py_DECREF(obj);
-                    Py_DECREF(self->pendingObject);
-                    self->pendingObject = NULL;
-                    if (x < 0) {
-                        return NULL;
-                    }
-                }
+                if (setMapItem(self, parent, task->idx, obj) == NULL)
+                    return NULL;
                 break;
             case VALKEY_REPLY_SET:
                 if (!self->convertSetsToLists) {
@@ -113,18 +383,46 @@ static void *tryParentize(const valkeyReadTask *task, PyObject *obj) {
                     return NULL;
                 }
         }
+        if (self->untrackReplies && isTracked(obj))
+            trackParents(task);
     }
     return obj;
 }
 
+static void countElement(const valkeyReadTask *task) {
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
+
+    if (self->stats != NULL)
+        STATS_COUNT_ELEMENT(self->stats, task->type);
+}
+
+/* Decodes a string with the errors handler of the reader. Codecs other than
+ * the ones decoded without a lookup may be written in Python. */
+static PyObject *_Reader_decode(libvalkey_ReaderObject *self, int decoder, const char *encoding,
+                                const char *str, size_t len) {
+    PyObject *obj;
+    int paused;
+
+    if (decoder != DECODE_GENERIC)
+        return Decode_String(decoder, encoding, self->errors, str, len);
+
+    paused = _Reader_begin_callback(self);
+    obj = Decode_String(decoder, encoding, self->errors, str, len);
+    _Reader_end_callback(self, paused);
+    return obj;
+}
+
 static PyObject *createDecodedString(libvalkey_ReaderObject *self, const char *str, size_t len) {
     PyObject *obj;
 
     if (self->encoding == NULL || !self->shouldDecode) {
         obj = PyBytes_FromStringAndSize(str, len);
     } else {
-        obj = PyUnicode_Decode(str, len, self->encoding, self->errors);
+        obj = _Reader_decode(self, self->decoder, self->encoding, str, len);
         if (obj == NULL) {
+            if (self->stats != NULL)
+                self->stats->decodeErrors++;
+
             /* Store error when this is the first. */
             if (self->error.ptype == NULL)
                 PyErr_Fetch(&(self->error.ptype), &(self->error.pvalue),
@@ -142,6 +440,25 @@ static PyObject *createDecodedString(libvalkey_ReaderObject *self, const char *s
     return obj;
 }
 
+/* Creates a map key, sharing the object with earlier keys that had the same
+ * raw bytes when interning is enabled. */
+static PyObject *createKeyString(libvalkey_ReaderObject *self, const char *str, size_t len) {
+    int decoded = self->encoding != NULL && self->shouldDecode;
+    PyObject *obj;
+
+    obj = InternCache_Get(self->internCache, str, len, decoded);
+    if (obj != NULL) {
+        Py_INCREF(obj);
+        return obj;
+    }
+
+    obj = createDecodedString(self, str, len);
+    /* Decoding errors leave a placeholder, which must not be cached. */
+    if (PyBytes_CheckExact(obj) || PyUnicode_CheckExact(obj))
+        InternCache_Put(self->internCache, str, len, decoded, obj);
+    return obj;
+}
+
 static void *createError(PyObject *errorCallable, char *errstr, size_t len) {
     PyObject *obj, *errmsg;
 
@@ -155,12 +472,79 @@ static void *createError(PyObject *errorCallable, char *errstr, size_t len) {
     return obj;
 }
 
+/* Creates a string value of a field of a 'fields' transform with the
+ * conversion of the field. Values that don't convert are reported like
+ * decoding errors. */
+static PyObject *createFieldString(libvalkey_ReaderObject *self, int conversion,
+                                   const char *str, size_t len) {
+    PyObject *obj, *bytes;
+    long long integer;
+    double dbl;
+
+    switch (conversion) {
+        case TRANSFORM_AS_IS:
+            return createDecodedString(self, str, len);
+        case TRANSFORM_BYTES:
+            obj = PyBytes_FromStringAndSize(str, len);
+            break;
+        case TRANSFORM_STR:
+            /* Decoded with the reader's encoding, or UTF-8 without one. */
+            if (self->encoding != NULL)
+                obj = _Reader_decode(self, self->decoder, self->encoding, str, len);
+            else
+                obj = Decode_String(DECODE_UTF8, "utf-8", NULL, str, len);
+            break;
+        case TRANSFORM_INT:
+            if (Parse_Integer(str, str + len, &integer) == 0) {
+                obj = PyLong_FromLongLong(integer);
+            } else {
+                bytes = PyBytes_FromStringAndSize(str, len);
+                obj = bytes ? PyNumber_Long(bytes) : NULL;
+                Py_XDECREF(bytes);
+            }
+            break;
+        default:
+            if (Parse_Double(str, len, &dbl) == 0) {
+                obj = PyFloat_FromDouble(dbl);
+            } else {
+                bytes = PyBytes_FromStringAndSize(str, len);
+                obj = bytes ? PyFloat_FromString(bytes) : NULL;
+                Py_XDECREF(bytes);
+            }
+    }
+
+    if (obj == NULL) {
+        if (self->error.ptype == NULL)
+            PyErr_Fetch(&(self->error.ptype), &(self->error.pvalue),
+                    &(self->error.ptraceback));
+        PyErr_Clear();
+        obj = Py_None;
+        Py_INCREF(obj);
+    }
+    return obj;
+}
+
 static void *createStringObject(const valkeyReadTask *task, char *str, size_t len) {
     libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
-    PyObject *obj;
+    libvalkey_TransformObject *transform;
+    PyObject *obj, *parent;
+    int paused;
+
+    countElement(task);
+    if (task->type != VALKEY_REPLY_ERROR && (parent = lazyParent(task)) != NULL) {
+        if (task->type == VALKEY_REPLY_VERB) {
+            str += 4;
+            len -= 4;
+        }
+        if (Lazy_AppendString(parent, str, len) < 0)
+            return NULL;
+        return parent;
+    }
 
     if (task->type == VALKEY_REPLY_ERROR) {
+        paused = _Reader_begin_callback(self);
         obj = createError(self->replyErrorClass, str, len);
+        _Reader_end_callback(self, paused);
         if (obj == NULL) {
             if (self->error.ptype == NULL)
                 PyErr_Fetch(&(self->error.ptype), &(self->error.pvalue),
@@ -174,7 +558,29 @@ static void *createStringObject(const valkeyReadTask *task, char *str, size_t le
             memmove(str, str+4, len);
             len -= 4;
         }
-        obj = createDecodedString(self, str, len);
+        if (transformParent(task)) {
+            transform = (libvalkey_TransformObject*)self->replyTransform;
+            if (transform->kind == TRANSFORM_FIELDS) {
+                if (task->idx % 2 == 0) {
+                    /* Field names are only looked up. */
+                    self->transformField = Transform_FindField(transform, str, len);
+                    return task->parent->obj;
+                }
+                if (self->transformField < 0)
+                    return task->parent->obj;
+                obj = createFieldString(self, transform->conversions[self->transformField],
+                                        str, len);
+            } else if (self->internCache != NULL && task->idx % 2 == 0) {
+                obj = createKeyString(self, str, len);
+            } else {
+                obj = createDecodedString(self, str, len);
+            }
+        } else if (self->internCache != NULL && task->parent != NULL &&
+                   task->parent->type == VALKEY_REPLY_MAP && task->idx % 2 == 0) {
+            obj = createKeyString(self, str, len);
+        } else {
+            obj = createDecodedString(self, str, len);
+        }
     }
     return tryParentize(task, obj);
 }
@@ -182,6 +588,46 @@ static void *createStringObject(const valkeyReadTask *task, char *str, size_t le
 static void *createArrayObject(const valkeyReadTask *task, size_t elements) {
     libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
     PyObject *obj;
+
+    countElement(task);
+
+    /* Replies with many elements would trigger collections while they are
+     * built, which can't find anything to collect in them. */
+    if (task->parent == NULL)
+        self->replyElements = 0;
+    self->replyElements += elements;
+    if (self->gcThreshold > 0 && self->replyElements >= self->gcThreshold)
+        _Reader_pause_gc(self);
+
+    if (task->parent == NULL) {
+        self->pushReply = task->type == VALKEY_REPLY_PUSH;
+
+        Py_CLEAR(self->replyTransform);
+        if (self->transform != NULL && elements % 2 == 0 &&
+            (task->type == VALKEY_REPLY_ARRAY || task->type == VALKEY_REPLY_MAP)) {
+            obj = Transform_NewReply((libvalkey_TransformObject*)self->transform, elements);
+            if (obj == NULL)
+                return NULL;
+            Py_INCREF(self->transform);
+            self->replyTransform = self->transform;
+            self->transformField = -1;
+            /* Tuples and dicts are tracked once they hold tracked objects. */
+            if (PyTuple_CheckExact(obj) || (self->untrackReplies && PyList_CheckExact(obj)))
+                PyObject_GC_UnTrack(obj);
+            return obj;
+        }
+    }
+
+    if (self->lazy) {
+        obj = Lazy_New(self->state, task->type == VALKEY_REPLY_MAP, elements,
+                       task->parent && !transformParent(task) ? (PyObject*)task->parent->obj : NULL,
+                       self->shouldDecode ? self->encoding : NULL, self->errors,
+                       self->decoder);
+        if (obj == NULL)
+            return NULL;
+        return tryParentize(task, obj);
+    }
+
     switch (task->type) {
         case VALKEY_REPLY_MAP:
             obj = PyDict_New();
@@ -195,29 +641,79 @@ static void *createArrayObject(const valkeyReadTask *task, size_t elements) {
         default:
             obj = PyList_New(elements);
     }
+    /* Maps aren't tracked until they hold tracked objects already. */
+    if (obj != NULL && self->untrackReplies && PyObject_GC_IsTracked(obj))
+        PyObject_GC_UnTrack(obj);
     return tryParentize(task, obj);
 }
 
+/* Returns the conversion of the field the element of task is the value of,
+ * or -1 when it isn't the value of a field of a 'fields' transform. */
+static int fieldConversion(const valkeyReadTask *task) {
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
+    libvalkey_TransformObject *transform = (libvalkey_TransformObject*)self->replyTransform;
+
+    if (!transformParent(task) || transform->kind != TRANSFORM_FIELDS || task->idx % 2 == 0 ||
+        self->transformField < 0)
+        return -1;
+    return transform->conversions[self->transformField];
+}
+
 static void *createIntegerObject(const valkeyReadTask *task, long long value) {
-    PyObject *obj;
-    obj = PyLong_FromLongLong(value);
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
+    PyObject *obj, *parent;
+    char digits[24];
+    int conversion, len;
+
+    countElement(task);
+    if ((parent = lazyParent(task)) != NULL)
+        return Lazy_AppendInteger(parent, value) < 0 ? NULL : parent;
+
+    /* Numbers are converted like the bulk strings they are written as. */
+    conversion = fieldConversion(task);
+    if (conversion == TRANSFORM_FLOAT) {
+        obj = PyFloat_FromDouble((double)value);
+    } else if (conversion == TRANSFORM_BYTES || conversion == TRANSFORM_STR) {
+        len = snprintf(digits, sizeof(digits), "%lld", value);
+        obj = createFieldString(self, conversion, digits, len);
+    } else {
+        obj = PyLong_FromLongLong(value);
+    }
     return tryParentize(task, obj);
 }
 
 static void *createDoubleObject(const valkeyReadTask *task, double value, char *str, size_t le) {
-    PyObject *obj;
-    obj = PyFloat_FromDouble(value);
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
+    PyObject *obj, *parent;
+    int conversion;
+
+    countElement(task);
+    if ((parent = lazyParent(task)) != NULL)
+        return Lazy_AppendDouble(parent, value) < 0 ? NULL : parent;
+
+    conversion = fieldConversion(task);
+    if (conversion == TRANSFORM_BYTES || conversion == TRANSFORM_STR ||
+        conversion == TRANSFORM_INT)
+        obj = createFieldString(self, conversion, str, le);
+    else
+        obj = PyFloat_FromDouble(value);
     return tryParentize(task, obj);
 }
 
 static void *createNilObject(const valkeyReadTask *task) {
-    PyObject *obj = Py_None;
+    PyObject *obj = Py_None, *parent;
+    countElement(task);
+    if ((parent = lazyParent(task)) != NULL)
+        return Lazy_AppendNil(parent) < 0 ? NULL : parent;
     Py_INCREF(obj);
     return tryParentize(task, obj);
 }
 
 static void *createBoolObject(const valkeyReadTask *task, int bval) {
-    PyObject *obj;
+    PyObject *obj, *parent;
+    countElement(task);
+    if ((parent = lazyParent(task)) != NULL)
+        return Lazy_AppendBool(parent, bval) < 0 ? NULL : parent;
     obj = PyBool_FromLong((long)bval);
     return tryParentize(task, obj);
 }
@@ -236,6 +732,152 @@ valkeyReplyObjectFunctions libvalkey_ObjectFunctions = {
     freeObject           // void (*freeObject)(void*);
 };
 
+/* Creates an array.array with the given type code from the bytes in data. */
+static PyObject *createArray(struct libvalkey_ModuleState *state, const char *typecode,
+                             PyObject *data) {
+    return PyObject_CallFunction(state->ArrayType, "sO", typecode, data);
+}
+
+/* Creates the (offsets, data) pair of columnar bulk strings: the strings
+ * concatenated in data, with string i at data[offsets[i]:offsets[i + 1]]. */
+static PyObject *createStringColumn(struct libvalkey_ModuleState *state,
+                                    const libvalkey_ParseNode *nodes, size_t count, char *start) {
+    PyObject *offsets, *data, *obj;
+    long long *offset;
+    size_t i, size = 0;
+    char *p;
+
+    for (i = 0; i < count; i++)
+        size += nodes[i].len;
+
+    offsets = PyBytes_FromStringAndSize(NULL, (count + 1) * sizeof(long long));
+    data = PyBytes_FromStringAndSize(NULL, size);
+    if (offsets == NULL || data == NULL)
+        goto error;
+
+    offset = (long long *)PyBytes_AS_STRING(offsets);
+    p = PyBytes_AS_STRING(data);
+    offset[0] = 0;
+    for (i = 0; i < count; i++) {
+        memcpy(p + offset[i], start + nodes[i].offset, nodes[i].len);
+        offset[i + 1] = offset[i] + nodes[i].len;
+    }
+
+    Py_SETREF(offsets, createArray(state, "q", offsets));
+    if (offsets == NULL)
+        goto error;
+    obj = PyTuple_Pack(2, offsets, data);
+    Py_DECREF(offsets);
+    Py_DECREF(data);
+    return obj;
+
+error:
+    Py_XDECREF(offsets);
+    Py_XDECREF(data);
+    return NULL;
+}
+
+/* Parses the len bytes at str as a double when they are the shortest text
+ * of a finite double, the way Python and Valkey write them, so converting
+ * them loses nothing. Returns 0 when they are and -1 otherwise. */
+static int parseCanonicalDouble(const char *str, size_t len, double *value) {
+    char *text;
+    int canonical;
+
+    if (Parse_Double(str, len, value) < 0 || !isfinite(*value))
+        return -1;
+
+    text = PyOS_double_to_string(*value, 'r', 0, 0, NULL);
+    if (text == NULL) {
+        PyErr_Clear();
+        return -1;
+    }
+    canonical = strlen(text) == len && memcmp(text, str, len) == 0;
+    PyMem_Free(text);
+    return canonical ? 0 : -1;
+}
+
+/* Creates arrays and sets of only integers and doubles as an array('q') or
+ * array('d'), and those of only bulk strings as numbers when all of them
+ * are numbers written the way they would be converted back, or as an
+ * (offsets, data) pair otherwise. */
+static int createColumnObject(const valkeyReadTask *task, const libvalkey_ParseNode *nodes,
+                              size_t count, char *start, void **result) {
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)task->privdata;
+    PyObject *data, *obj;
+    long long *integers;
+    double *doubles;
+    size_t i, numbers = 0, reals = 0, strings = 0;
+    const char *typecode;
+
+    if (task->type != VALKEY_REPLY_ARRAY && task->type != VALKEY_REPLY_SET)
+        return 0;
+    /* Replies are transformed element by element. */
+    if (task->parent == NULL && self->transform != NULL)
+        return 0;
+
+    for (i = 0; i < count; i++) {
+        if (nodes[i].type == VALKEY_REPLY_INTEGER)
+            numbers++;
+        else if (nodes[i].type == VALKEY_REPLY_DOUBLE)
+            numbers++, reals++;
+        else if (nodes[i].type == VALKEY_REPLY_STRING)
+            strings++;
+    }
+    if (numbers != count && strings != count)
+        return 0;
+
+    data = PyBytes_FromStringAndSize(NULL, count * sizeof(long long));
+    if (data == NULL)
+        return -1;
+    integers = (long long *)PyBytes_AS_STRING(data);
+    doubles = (double *)PyBytes_AS_STRING(data);
+
+    if (numbers == count) {
+        typecode = reals > 0 ? "d" : "q";
+        for (i = 0; i < count; i++) {
+            if (reals == 0)
+                integers[i] = nodes[i].value.integer;
+            else if (nodes[i].type == VALKEY_REPLY_DOUBLE)
+                doubles[i] = nodes[i].value.dbl;
+            else
+                doubles[i] = (double)nodes[i].value.integer;
+        }
+    } else {
+        typecode = "q";
+        for (i = 0; i < count; i++) {
+            const char *p = start + nodes[i].offset;
+            if (Parse_Integer(p, p + nodes[i].len, &integers[i]) < 0)
+                break;
+        }
+        if (i < count) {
+            typecode = "d";
+            for (i = 0; i < count; i++)
+                if (parseCanonicalDouble(start + nodes[i].offset, nodes[i].len, &doubles[i]) < 0)
+                    break;
+        }
+        if (i < count)
+            typecode = NULL;
+    }
+
+    if (typecode != NULL)
+        obj = createArray(self->state, typecode, data);
+    else
+        obj = createStringColumn(self->state, nodes, count, start);
+    Py_DECREF(data);
+    if (obj == NULL)
+        return -1;
+
+    if (self->stats != NULL) {
+        STATS_COUNT_ELEMENT(self->stats, task->type);
+        for (i = 0; i < count; i++)
+            STATS_COUNT_ELEMENT(self->stats, nodes[i].type);
+    }
+
+    *result = tryParentize(task, obj);
+    return *result == NULL ? -1 : 1;
+}
+
 static void Reader_dealloc(libvalkey_ReaderObject *self) {
     PyObject_GC_UnTrack(self);
     // we don't need to free self->encoding as the buffer is managed by Python
@@ -244,14 +886,39 @@ static void Reader_dealloc(libvalkey_ReaderObject *self) {
     Py_CLEAR(self->protocolErrorClass);
     Py_CLEAR(self->replyErrorClass);
     Py_CLEAR(self->notEnoughDataObject);
-
-    ((PyObject *)self)->ob_type->tp_free((PyObject*)self);
+    Py_CLEAR(self->bufferView);
+    Py_CLEAR(self->pushHandler);
+    Py_CLEAR(self->streamHandler);
+    Py_CLEAR(self->replyTransform);
+    Py_CLEAR(self->transformDiscard);
+    InternCache_Free(self->internCache);
+    Parse_Reset(&self->parser);
+    Stats_Free(self->stats);
+
+    PyTypeObject *type = Py_TYPE(self);
+    type->tp_free((PyObject*)self);
+    Py_DECREF(type);
 }
 
 static int Reader_traverse(libvalkey_ReaderObject *self, visitproc visit, void *arg) {
+    Py_VISIT(Py_TYPE(self));
     Py_VISIT(self->protocolErrorClass);
     Py_VISIT(self->replyErrorClass);
     Py_VISIT(self->notEnoughDataObject);
+    Py_VISIT(self->bufferView);
+    Py_VISIT(self->pushHandler);
+    Py_VISIT(self->streamHandler);
+    Py_VISIT(self->replyTransform);
+    Py_VISIT(self->transformDiscard);
+    return 0;
+}
+
+static int Reader_clear(libvalkey_ReaderObject *self) {
+    Py_CLEAR(self->bufferView);
+    Py_CLEAR(self->pushHandler);
+    Py_CLEAR(self->streamHandler);
+    Py_CLEAR(self->replyTransform);
+    Py_CLEAR(self->transformDiscard);
     return 0;
 }
 
@@ -286,6 +953,7 @@ static int _Reader_set_encoding(libvalkey_ReaderObject *self, char *encoding, ch
     } else {
         self->encoding = NULL;
     }
+    self->decoder = Decode_Lookup(self->encoding);
 
     if (errors) {   // validate that the error handler exists, raises LookupError if not
         codecs = PyImport_ImportModule("codecs");
@@ -301,10 +969,28 @@ static int _Reader_set_encoding(libvalkey_ReaderObject *self, char *encoding, ch
         self->errors = "strict";
     }
 
+    /* Cached keys were decoded with the previous settings. */
+    if (self->internCache != NULL)
+        InternCache_Clear(self->internCache);
+
     return 0;
 }
 
-static int Reader_init(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+/* Counts the buffer as reallocated when it moved or changed its size since
+ * it was old with alloc bytes, and keeps track of its largest size. Without
+ * an old buffer only the size is tracked. */
+static void _Reader_track_buffer(libvalkey_ReaderObject *self, sds old, size_t alloc) {
+    sds buf = self->reader->buf;
+
+    if (buf == NULL)
+        return;
+    if (old != NULL && (buf != old || sdsalloc(buf) != alloc))
+        self->stats->bufferReallocations++;
+    if (sdsalloc(buf) > self->stats->bufferPeak)
+        self->stats->bufferPeak = sdsalloc(buf);
+}
+
+static int _Reader_init(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
     static char *kwlist[] = {
         "protocolError",
         "replyError",
@@ -312,6 +998,16 @@ static int Reader_init(libvalkey_ReaderObject *self, PyObject *args, PyObject *k
         "errors",
         "notEnoughData",
         "convertSetsToLists",
+        "lazy",
+        "internKeys",
+        "pushHandler",
+        "releaseGilThreshold",
+        "columnar",
+        "stats",
+        "streamHandler",
+        "streamThreshold",
+        "gcThreshold",
+        "untrackReplies",
         NULL,
     };
     PyObject *protocolErrorClass = NULL;
@@ -320,11 +1016,51 @@ static int Reader_init(libvalkey_ReaderObject *self, PyObject *args, PyObject *k
     char *encoding = NULL;
     char *errors = NULL;
     int convertSetsToLists = 0;
+    int lazy = 0;
+    Py_ssize_t internKeys = 0;
+    PyObject *pushHandler = NULL;
+    Py_ssize_t releaseGilThreshold = 0;
+    int columnar = 0;
+    int stats = 0;
+    PyObject *streamHandler = NULL;
+    Py_ssize_t streamThreshold = READER_STREAM_THRESHOLD;
+    Py_ssize_t gcThreshold = 0;
+    int untrackReplies = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOzzOppnOnppOnnp", kwlist,
+        &protocolErrorClass, &replyErrorClass, &encoding, &errors, &notEnoughData, &convertSetsToLists,
+        &lazy, &internKeys, &pushHandler, &releaseGilThreshold, &columnar, &stats,
+        &streamHandler, &streamThreshold, &gcThreshold, &untrackReplies))
+            return -1;
+
+    if (pushHandler)
+        if (Reader_set_push_handler(self, pushHandler) == NULL)
+            return -1;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOzzOp", kwlist,
-        &protocolErrorClass, &replyErrorClass, &encoding, &errors, &notEnoughData, &convertSetsToLists))
+    if (streamHandler)
+        if (Reader_set_stream_handler(self, streamHandler) == NULL)
             return -1;
 
+    if (streamThreshold < 1) {
+        PyErr_SetString(PyExc_ValueError, "streamThreshold must be positive");
+        return -1;
+    }
+
+    if (internKeys < 0) {
+        PyErr_SetString(PyExc_ValueError, "internKeys must not be negative");
+        return -1;
+    }
+
+    if (releaseGilThreshold < 0) {
+        PyErr_SetString(PyExc_ValueError, "releaseGilThreshold must not be negative");
+        return -1;
+    }
+
+    if (gcThreshold < 0) {
+        PyErr_SetString(PyExc_ValueError, "gcThreshold must not be negative");
+        return -1;
+    }
+
     if (protocolErrorClass)
         if (!_Reader_set_exception(&self->protocolErrorClass, protocolErrorClass))
             return -1;
@@ -341,26 +1077,87 @@ static int Reader_init(libvalkey_ReaderObject *self, PyObject *args, PyObject *k
     }
 
     self->convertSetsToLists = convertSetsToLists;
+    self->lazy = lazy;
+    self->releaseGilThreshold = (size_t)releaseGilThreshold;
+    self->columnar = columnar;
+    self->streamThreshold = (size_t)streamThreshold;
+    self->gcThreshold = (size_t)gcThreshold;
+    self->untrackReplies = untrackReplies;
+
+    InternCache_Free(self->internCache);
+    self->internCache = NULL;
+    if (internKeys > 0) {
+        self->internCache = InternCache_New(internKeys);
+        if (self->internCache == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+
+    if (!stats) {
+        Stats_Free(self->stats);
+        self->stats = NULL;
+    } else if (self->stats == NULL) {
+        self->stats = Stats_New();
+        if (self->stats == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        _Reader_track_buffer(self, NULL, 0);
+    }
 
     return _Reader_set_encoding(self, encoding, errors);
 }
 
+static int Reader_init(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+    int result;
+    Py_BEGIN_CRITICAL_SECTION(self);
+    result = _Reader_check_busy(self) < 0 ? -1 : _Reader_init(self, args, kwds);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
 static PyObject *Reader_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    struct libvalkey_ModuleState *state;
     libvalkey_ReaderObject *self;
+
+    state = libvalkey_GetStateByType(type);
+    if (state == NULL)
+        return NULL;
+
     self = (libvalkey_ReaderObject*)type->tp_alloc(type, 0);
     if (self != NULL) {
+        self->state = state;
         self->reader = valkeyReaderCreateWithFunctions(NULL);
         self->reader->fn = &libvalkey_ObjectFunctions;
         self->reader->privdata = self;
 
         self->encoding = NULL;
+        self->decoder = DECODE_GENERIC;
         self->errors = "strict";  // default to "strict" to mimic Python
         self->notEnoughDataObject = Py_False;
         self->shouldDecode = 1;
-        self->protocolErrorClass = LIBVALKEY_STATE->VkErr_ProtocolError;
-        self->replyErrorClass = LIBVALKEY_STATE->VkErr_ReplyError;
+        self->protocolErrorClass = state->VkErr_ProtocolError;
+        self->replyErrorClass = state->VkErr_ReplyError;
         self->pendingObject = NULL;
+        self->transform = NULL;
+        self->replyTransform = NULL;
+        self->transformField = -1;
+        self->transformDiscard = NULL;
         self->convertSetsToLists = 0;
+        self->lazy = 0;
+        self->internCache = NULL;
+        self->pushHandler = NULL;
+        self->pushReply = 0;
+        self->streamHandler = NULL;
+        self->streamThreshold = READER_STREAM_THRESHOLD;
+        self->gcThreshold = 0;
+        self->replyElements = 0;
+        self->gcPaused = 0;
+        self->untrackReplies = 0;
+        self->streaming = 0;
+        self->streamSize = 0;
+        self->streamRemaining = 0;
         Py_INCREF(self->protocolErrorClass);
         Py_INCREF(self->replyErrorClass);
         Py_INCREF(self->notEnoughDataObject);
@@ -368,10 +1165,60 @@ static PyObject *Reader_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         self->error.ptype = NULL;
         self->error.pvalue = NULL;
         self->error.ptraceback = NULL;
+
+        self->bufferView = NULL;
+        self->bufferExports = 0;
+        self->bufferReserved = 0;
+
+        self->rawScanned = 0;
+        self->rawPending = 0;
+
+        memset(&self->parser, 0, sizeof(self->parser));
+        self->releaseGilThreshold = 0;
+        self->busy = 0;
+        self->columnar = 0;
+        self->stats = NULL;
     }
     return (PyObject*)self;
 }
 
+/* Releases the view handed out by #get_buffer, so it can't be written to
+ * once the buffer moves. The view stays exported when the caller derived
+ * other buffers from it; #_Reader_check_buffer_exports catches that. */
+static void _Reader_release_buffer_view(libvalkey_ReaderObject *self) {
+    PyObject *view, *res, *ptype, *pvalue, *ptraceback;
+
+    self->bufferReserved = 0;
+    if (self->bufferView == NULL)
+        return;
+
+    view = self->bufferView;
+    self->bufferView = NULL;
+
+    PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+    res = PyObject_CallMethod(view, "release", NULL);
+    Py_XDECREF(res);
+    Py_DECREF(view);
+    PyErr_Restore(ptype, pvalue, ptraceback);
+}
+
+static int _Reader_check_buffer_exports(libvalkey_ReaderObject *self) {
+    if (self->bufferExports > 0) {
+        PyErr_SetString(PyExc_BufferError,
+                        "Existing exports of data: buffer cannot be re-sized");
+        return -1;
+    }
+    return 0;
+}
+
+/* Reading replies discards consumed data by moving the rest to the start of
+ * the buffer, after which an uncommitted reservation from #get_buffer would
+ * no longer end the data. It is dropped before reading, like #feed does. */
+static int _Reader_drop_reservation(libvalkey_ReaderObject *self) {
+    _Reader_release_buffer_view(self);
+    return _Reader_check_buffer_exports(self);
+}
+
 static PyObject *Reader_feed(libvalkey_ReaderObject *self, PyObject *args) {
     Py_buffer buf;
     Py_ssize_t off = 0;
@@ -395,7 +1242,22 @@ static PyObject *Reader_feed(libvalkey_ReaderObject *self, PyObject *args) {
       goto error;
     }
 
-    valkeyReaderFeed(self->reader, (char *)buf.buf + off, len);
+    /* Appending may move the buffer, which views from #get_buffer point
+     * into. Data fed here also invalidates an uncommitted reservation. */
+    _Reader_release_buffer_view(self);
+    if (_Reader_check_buffer_exports(self) < 0)
+      goto error;
+
+    if (self->stats != NULL) {
+        sds old = self->reader->buf;
+        size_t alloc = sdsalloc(old);
+
+        valkeyReaderFeed(self->reader, (char *)buf.buf + off, len);
+        self->stats->bytesFed += len;
+        _Reader_track_buffer(self, old, alloc);
+    } else {
+        valkeyReaderFeed(self->reader, (char *)buf.buf + off, len);
+    }
     PyBuffer_Release(&buf);
     Py_RETURN_NONE;
 
@@ -404,94 +1266,1049 @@ error:
     return NULL;
 }
 
-static PyObject *Reader_gets(libvalkey_ReaderObject *self, PyObject *args) {
-    PyObject *obj;
-
-    self->shouldDecode = 1;
-    if (!PyArg_ParseTuple(args, "|i", &self->shouldDecode)) {
-        return NULL;
-    }
-
-    if (valkeyReaderGetReply(self->reader, (void**)&obj) == VALKEY_ERR) {
-        PyObject *err = NULL;
-        char *errstr = valkeyReaderGetError(self->reader);
-        /* This is a hack to avoid
-         * "SystemError: class returned a result with an exception set".
-         * It is caused by the fact that one of callbacks already set an
-         * exception (i.e. failed PyDict_SetItem). Calling createError()
-         * after an exception is set will raise SystemError as per
-         * https://github.com/python/cpython/issues/67759.
-         * Hence, only call createError() if there is no exception set.
-         */
-        if (PyErr_Occurred() == NULL) {
-            /* protocolErrorClass might be a callable. call it, then use it's type */
-            err = createError(self->protocolErrorClass, errstr, strlen(errstr));
-        }
-        if (err != NULL) {
-            obj = PyObject_Type(err);
-            PyErr_SetString(obj, errstr);
-            Py_DECREF(obj);
-            Py_DECREF(err);
-        }
-        return NULL;
+static void _Reader_raise_protocol_error(libvalkey_ReaderObject *self, char *errstr) {
+    PyObject *err = NULL, *type;
+    /* This is a hack to avoid
+     * "SystemError: class returned a result with an exception set".
+     * It is caused by the fact that one of callbacks already set an
+     * exception (i.e. failed PyDict_SetItem). Calling createError()
+     * after an exception is set will raise SystemError as per
+     * https://github.com/python/cpython/issues/67759.
+     * Hence, only call createError() if there is no exception set.
+     */
+    if (PyErr_Occurred() == NULL) {
+        /* protocolErrorClass might be a callable. call it, then use it's type */
+        err = createError(self->protocolErrorClass, errstr, strlen(errstr));
     }
-
-    if (obj == NULL) {
-        Py_INCREF(self->notEnoughDataObject);
-        return self->notEnoughDataObject;
-    } else {
-        /* Restore error when there is one. */
-        if (self->error.ptype != NULL) {
-            Py_DECREF(obj);
-            PyErr_Restore(self->error.ptype, self->error.pvalue,
-                    self->error.ptraceback);
-            self->error.ptype = NULL;
-            self->error.pvalue = NULL;
-            self->error.ptraceback = NULL;
-            return NULL;
-        }
-        return obj;
+    if (err != NULL) {
+        type = PyObject_Type(err);
+        PyErr_SetString(type, errstr);
+        Py_DECREF(type);
+        Py_DECREF(err);
     }
 }
 
-static PyObject *Reader_setmaxbuf(libvalkey_ReaderObject *self, PyObject *arg) {
-    long maxbuf;
-
-    if (arg == Py_None)
-        maxbuf = VALKEY_READER_MAX_BUF;
-    else {
-        maxbuf = PyLong_AsLong(arg);
-        if (maxbuf < 0) {
-            if (!PyErr_Occurred())
-                PyErr_SetString(PyExc_ValueError,
-                                "maxbuf value out of range");
-            return NULL;
-        }
-    }
-    self->reader->maxbuf = maxbuf;
-
-    Py_INCREF(Py_None);
-    return Py_None;
+static void _Reader_set_protocol_error(libvalkey_ReaderObject *self) {
+    _Reader_raise_protocol_error(self, valkeyReaderGetError(self->reader));
 }
 
-static PyObject *Reader_getmaxbuf(libvalkey_ReaderObject *self) {
-    return PyLong_FromSize_t(self->reader->maxbuf);
+static void _Reader_restore_error(libvalkey_ReaderObject *self) {
+    PyErr_Restore(self->error.ptype, self->error.pvalue,
+            self->error.ptraceback);
+    self->error.ptype = NULL;
+    self->error.pvalue = NULL;
+    self->error.ptraceback = NULL;
 }
 
-static PyObject *Reader_len(libvalkey_ReaderObject *self) {
-    return PyLong_FromSize_t(self->reader->len);
+/* Whether the reader is in between replies. It sets up the task for the
+ * next reply when it runs out of data, before reading its type. */
+static int _Reader_between_replies(valkeyReader *r) {
+    return r->ridx == -1 || (r->ridx == 0 && r->task[0]->type < 0);
 }
 
-static PyObject *Reader_has_data(libvalkey_ReaderObject *self) {
-    if(self->reader->pos < self->reader->len)
-        Py_RETURN_TRUE;
-    Py_RETURN_FALSE;
-}
+/* Marks size bytes as read by something other than the reader. */
+static void _Reader_consume(libvalkey_ReaderObject *self, size_t size) {
+    valkeyReader *r = self->reader;
 
-static PyObject *Reader_set_encoding(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
-    static char *kwlist[] = { "encoding", "errors", NULL };
-    char *encoding = NULL;
-    char *errors = NULL;
+    r->pos += size;
+    self->rawScanned = 0;
+    Parse_Reset(&self->parser);
+
+    /* Discard the consumed data the same way the reader does. */
+    if (r->pos >= 1024) {
+        sdsrange(r->buf, r->pos, -1);
+        r->pos = 0;
+        r->len = sdslen(r->buf);
+    }
+}
+
+/* Reads the next reply like valkeyReaderGetReply. Aggregates of at least
+ * releaseGilThreshold bytes are read in two phases instead: the reply is
+ * tokenized with the GIL released, and its objects are created from the
+ * tokens afterwards. Columnar output needs the tokens as well, so then all
+ * aggregates are read this way. Anything that doesn't tokenize cleanly is
+ * left for the reader, so errors are reported the same way. */
+static int _Reader_get_reply(libvalkey_ReaderObject *self, void **reply) {
+    valkeyReader *r = self->reader;
+    libvalkey_Parser *parser = &self->parser;
+    size_t threshold = self->releaseGilThreshold;
+    char *start, *end;
+    size_t size;
+    int ret = PARSE_LIMIT, release;
+
+    *reply = NULL;
+    if ((threshold == 0 && !self->columnar) || r->err || !_Reader_between_replies(r))
+        goto reader;
+
+    /* A reply that was tokenized in part is finished the same way. */
+    start = r->buf + r->pos;
+    end = r->buf + r->len;
+    release = threshold > 0 && (parser->pos > 0 || (size_t)(end - start) >= threshold);
+    if (parser->pos == 0) {
+        if ((!release && !self->columnar) || *start == '\0' ||
+            strchr("*~>%|", *start) == NULL)
+            goto reader;
+
+        /* Replies that turn out to be smaller are tokenized without
+         * releasing the GIL. */
+        ret = Parse_Tokenize(parser, start, end, r->maxelements, release ? threshold : 0);
+    } else if (!release) {
+        ret = Parse_Tokenize(parser, start, end, r->maxelements, 0);
+    }
+
+    if (ret == PARSE_LIMIT) {
+        /* Other threads can run now, but can't use the reader until it is
+         * done with the buffer. */
+        self->busy = 1;
+        Py_BEGIN_ALLOW_THREADS
+        ret = Parse_Tokenize(parser, start, end, r->maxelements, 0);
+        Py_END_ALLOW_THREADS
+        self->busy = 0;
+    }
+
+    if (ret == PARSE_INCOMPLETE)
+        return VALKEY_OK;
+    if (ret == PARSE_ERROR)
+        goto reader;
+
+    size = parser->pos;
+    *reply = Parse_Build(parser, start, r->fn,
+                         self->columnar ? createColumnObject : NULL, r->privdata);
+    _Reader_consume(self, size);
+    if (*reply == NULL) {
+        if (!PyErr_Occurred())
+            PyErr_NoMemory();
+        return VALKEY_ERR;
+    }
+    return VALKEY_OK;
+
+reader:
+    /* The reader moves through the buffer on its own from here. */
+    Parse_Reset(parser);
+    self->rawScanned = 0;
+    return valkeyReaderGetReply(r, reply);
+}
+
+/* Starts streaming the next reply when it is a bulk string of at least
+ * streamThreshold bytes. Returns 1 when it does, 0 when the reply is read
+ * as usual and -1 when its header hasn't arrived yet. */
+static int _Reader_stream_start(libvalkey_ReaderObject *self) {
+    valkeyReader *r = self->reader;
+    const char *p, *end, *eol;
+    long long len;
+
+    if (r->err || r->pos == r->len || r->buf[r->pos] != '$' || !_Reader_between_replies(r))
+        return 0;
+
+    p = r->buf + r->pos;
+    end = r->buf + r->len;
+    eol = memchr(p, '\r', end - p);
+    if (eol == NULL || eol + 1 == end)
+        return -1;
+
+    /* Anything unusual is left for the reader to report. */
+    if (eol[1] != '\n' || Parse_Integer(p + 1, eol, &len) < 0 || len < 0 ||
+        (unsigned long long)len < self->streamThreshold)
+        return 0;
+
+    _Reader_consume(self, eol + 2 - p);
+    self->streaming = 1;
+    self->streamSize = (size_t)len;
+    self->streamRemaining = (size_t)len;
+    return 1;
+}
+
+/* Passes the buffered part of the bulk string being streamed to the stream
+ * handler. Returns 1 and stores its size in *reply once it is complete, 0
+ * when more data is needed and -1 with an exception set on errors. Without
+ * a handler the data is dropped. */
+static int _Reader_stream(libvalkey_ReaderObject *self, PyObject **reply) {
+    valkeyReader *r = self->reader;
+    PyObject *chunk, *handler, *result;
+    size_t size;
+
+    size = r->len - r->pos;
+    if (size > self->streamRemaining)
+        size = self->streamRemaining;
+
+    if (size > 0) {
+        chunk = NULL;
+        if (self->streamHandler != NULL) {
+            chunk = PyBytes_FromStringAndSize(r->buf + r->pos, size);
+            if (chunk == NULL)
+                return -1;
+        }
+        self->streamRemaining -= size;
+        _Reader_consume(self, size);
+
+        if (chunk != NULL) {
+            /* The handler may replace itself while it runs. */
+            handler = self->streamHandler;
+            Py_INCREF(handler);
+            result = PyObject_CallFunctionObjArgs(handler, chunk, NULL);
+            Py_DECREF(handler);
+            Py_DECREF(chunk);
+            if (result == NULL)
+                return -1;
+            Py_DECREF(result);
+        }
+    }
+
+    /* The line break after the data is skipped like the reader does. */
+    if (self->streamRemaining > 0 || r->len - r->pos < 2)
+        return 0;
+    _Reader_consume(self, 2);
+    self->streaming = 0;
+
+    *reply = StreamedReply_New(self->state->StreamedReplyType, (Py_ssize_t)self->streamSize);
+    if (*reply == NULL)
+        return -1;
+    if (self->stats != NULL) {
+        self->stats->replies++;
+        self->stats->elements[VALKEY_REPLY_STRING]++;
+    }
+    return 1;
+}
+
+/* Reads the next reply from the buffer like #_Reader_read_reply, but hands
+ * out push replies as well. *push is set to whether the reply read is a push
+ * reply. */
+static int _Reader_read_one(libvalkey_ReaderObject *self, PyObject **reply, int *push) {
+    PyObject *obj, *transform;
+    int ret;
+
+    *reply = NULL;
+    *push = 0;
+
+    if (self->streaming || self->streamHandler != NULL) {
+        ret = self->streaming ? 1 : _Reader_stream_start(self);
+        if (ret == -1)
+            return 0;
+        if (ret == 1)
+            return _Reader_stream(self, reply);
+    }
+
+    /* Keep collection paused for a large reply started by an earlier
+     * call. */
+    if (self->gcThreshold > 0 && self->replyElements >= self->gcThreshold)
+        _Reader_pause_gc(self);
+
+    if (self->stats != NULL) {
+        unsigned long long start = Stats_Now();
+
+        ret = _Reader_get_reply(self, (void**)&obj);
+        self->stats->parseNs += Stats_Now() - start;
+        if (obj != NULL)
+            self->stats->replies++;
+    } else {
+        ret = _Reader_get_reply(self, (void**)&obj);
+    }
+    _Reader_resume_gc(self);
+
+    if (ret == VALKEY_ERR) {
+        self->pushReply = 0;
+        self->replyElements = 0;
+        Py_CLEAR(self->replyTransform);
+        Py_CLEAR(self->transformDiscard);
+        /* The reader frees its buffer on errors. */
+        _Reader_release_buffer_view(self);
+        _Reader_set_protocol_error(self);
+        return -1;
+    }
+
+    if (obj == NULL)
+        return 0;
+
+    *push = self->pushReply;
+    self->pushReply = 0;
+    self->replyElements = 0;
+    transform = self->replyTransform;
+    self->replyTransform = NULL;
+    Py_CLEAR(self->transformDiscard);
+
+    /* Restore error when there is one. */
+    if (self->error.ptype != NULL) {
+        Py_DECREF(obj);
+        Py_XDECREF(transform);
+        _Reader_restore_error(self);
+        return *push ? -1 : -2;
+    }
+
+    if (transform != NULL) {
+        obj = Transform_Finish((libvalkey_TransformObject*)transform, obj);
+        Py_DECREF(transform);
+        if (obj == NULL)
+            return -2;
+    }
+
+    *reply = obj;
+    return 1;
+}
+
+/* Passes a push reply to the push handler. Steals obj. */
+static int _Reader_call_push_handler(libvalkey_ReaderObject *self, PyObject *obj) {
+    PyObject *handler, *result;
+
+    /* The handler may replace itself while it runs. */
+    handler = self->pushHandler;
+    Py_INCREF(handler);
+    result = PyObject_CallFunctionObjArgs(handler, obj, NULL);
+    Py_DECREF(handler);
+    Py_DECREF(obj);
+    if (result == NULL)
+        return -1;
+    Py_DECREF(result);
+    return 0;
+}
+
+/* Reads the next reply from the buffer. Returns 1 and stores a new reference
+ * in *reply when a full reply was read, 0 when more data is needed and -1
+ * with an exception set on errors. Returns -2 with an exception set when a
+ * full reply was read, but converting it failed. Push replies are passed to
+ * the push handler when there is one, and reading continues with the next
+ * reply. */
+static int _Reader_read_reply(libvalkey_ReaderObject *self, PyObject **reply) {
+    PyObject *obj;
+    int push, ret;
+
+    *reply = NULL;
+
+    /* Raise an error that #gets_many kept back because it already had
+     * replies to return. */
+    if (self->error.ptype != NULL && self->reader->ridx == -1) {
+        _Reader_restore_error(self);
+        return -1;
+    }
+
+    for (;;) {
+        ret = _Reader_read_one(self, &obj, &push);
+        if (ret != 1)
+            return ret;
+
+        if (!push || self->pushHandler == NULL) {
+            *reply = obj;
+            return 1;
+        }
+
+        if (_Reader_call_push_handler(self, obj) < 0)
+            return -1;
+    }
+}
+
+/* Sets the ReplyTransform that replies started by the call are created
+ * with. */
+static int _Reader_set_transform(libvalkey_ReaderObject *self, PyObject *transform) {
+    self->transform = NULL;
+    if (transform == Py_None)
+        return 0;
+
+    if (!PyObject_TypeCheck(transform, self->state->ReplyTransformType)) {
+        PyErr_Format(PyExc_TypeError, "transform must be a ReplyTransform, not %.100s",
+                     Py_TYPE(transform)->tp_name);
+        return -1;
+    }
+    self->transform = transform;
+    return 0;
+}
+
+static PyObject *Reader_gets(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "shouldDecode", "transform", NULL };
+    PyObject *obj, *transform = Py_None;
+    int ret;
+
+    self->shouldDecode = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iO", kwlist, &self->shouldDecode,
+                                     &transform)) {
+        return NULL;
+    }
+    if (_Reader_drop_reservation(self) < 0 || _Reader_set_transform(self, transform) < 0)
+        return NULL;
+
+    ret = _Reader_read_reply(self, &obj);
+    self->transform = NULL;
+    if (ret < 0)
+        return NULL;
+
+    if (ret == 0) {
+        Py_INCREF(self->notEnoughDataObject);
+        return self->notEnoughDataObject;
+    }
+    return obj;
+}
+
+/* Converts the optional max argument of the #gets_* methods. */
+static int _Reader_parse_max(PyObject *maxObj, Py_ssize_t *max) {
+    *max = PY_SSIZE_T_MAX;
+    if (maxObj == Py_None)
+        return 0;
+
+    *max = PyLong_AsSsize_t(maxObj);
+    if (*max == -1 && PyErr_Occurred())
+        return -1;
+    if (*max < 0) {
+        PyErr_SetString(PyExc_ValueError, "max must not be negative");
+        return -1;
+    }
+    return 0;
+}
+
+/* Number of replies #gets_many collects before it needs to allocate room
+ * for more. */
+#define READER_GETS_MANY_INLINE 64
+
+static PyObject *Reader_gets_many(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "max", "shouldDecode", "transform", NULL };
+    PyObject *maxObj = Py_None, *transform = Py_None;
+    PyObject *inline_items[READER_GETS_MANY_INLINE];
+    PyObject **items = inline_items, **grown;
+    PyObject *replies = NULL, *obj;
+    Py_ssize_t max = PY_SSIZE_T_MAX, n = 0, cap = READER_GETS_MANY_INLINE, i;
+    int ret;
+
+    self->shouldDecode = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OiO", kwlist, &maxObj, &self->shouldDecode,
+                                     &transform))
+        return NULL;
+
+    if (_Reader_parse_max(maxObj, &max) < 0 || _Reader_drop_reservation(self) < 0 ||
+        _Reader_set_transform(self, transform) < 0)
+        return NULL;
+
+    /* The replies are collected first, so the list is created with the
+     * size it ends up with instead of growing with every reply. */
+    while (n < max) {
+        ret = _Reader_read_reply(self, &obj);
+        if (ret == 0)
+            break;
+
+        if (ret < 0) {
+            if (n == 0)
+                goto error;
+            /* Hand out the replies read so far and raise the error on the
+             * next call, like a loop over #gets would. */
+            PyErr_Fetch(&(self->error.ptype), &(self->error.pvalue),
+                    &(self->error.ptraceback));
+            break;
+        }
+
+        if (n == cap) {
+            grown = PyMem_Malloc(2 * cap * sizeof(*items));
+            if (grown == NULL) {
+                Py_DECREF(obj);
+                PyErr_NoMemory();
+                goto error;
+            }
+            memcpy(grown, items, n * sizeof(*items));
+            if (items != inline_items)
+                PyMem_Free(items);
+            items = grown;
+            cap *= 2;
+        }
+        items[n++] = obj;
+    }
+
+    replies = PyList_New(n);
+    if (replies == NULL)
+        goto error;
+    for (i = 0; i < n; i++)
+        PyList_SET_ITEM(replies, i, items[i]);
+    n = 0;
+
+error:
+    self->transform = NULL;
+    for (i = 0; i < n; i++)
+        Py_DECREF(items[i]);
+    if (items != inline_items)
+        PyMem_Free(items);
+    return replies;
+}
+
+/* Finds the end of the next complete reply without creating any objects.
+ * Returns 1 and stores the size of the reply when it is complete, 0 when
+ * more data is needed and -1 with an exception set on protocol errors.
+ * Progress through incomplete replies is kept in rawScanned and rawPending,
+ * so data is only scanned once no matter how it arrives. */
+static int _Reader_scan_raw(libvalkey_ReaderObject *self, size_t *size) {
+    valkeyReader *r = self->reader;
+    size_t scanned = self->rawScanned;
+    long long pending = scanned > 0 ? self->rawPending : 1;
+    char errstr[64];
+    int ret;
+
+    ret = Parse_Frame(r->buf + r->pos, r->buf + r->len, r->maxelements,
+                      &scanned, &pending, errstr, sizeof(errstr));
+    if (ret == PARSE_ERROR) {
+        _Reader_raise_protocol_error(self, errstr);
+        return -1;
+    }
+    if (ret == PARSE_INCOMPLETE) {
+        self->rawScanned = scanned;
+        self->rawPending = pending;
+        return 0;
+    }
+
+    self->rawScanned = 0;
+    *size = scanned;
+    return 1;
+}
+
+/* Checks that the buffer can be read without going through the reader,
+ * which is the case in between replies. */
+static int _Reader_check_between_replies(libvalkey_ReaderObject *self, const char *method) {
+    valkeyReader *r = self->reader;
+
+    if (r->err) {
+        _Reader_set_protocol_error(self);
+        return -1;
+    }
+
+    if (self->error.ptype != NULL && _Reader_between_replies(r)) {
+        _Reader_restore_error(self);
+        return -1;
+    }
+
+    if (!_Reader_between_replies(r) || self->streaming) {
+        PyErr_Format(PyExc_RuntimeError,
+                     "%s() can't be used while gets() has read part of a reply", method);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *Reader_gets_raw(libvalkey_ReaderObject *self, PyObject *unused) {
+    valkeyReader *r = self->reader;
+    PyObject *obj;
+    size_t size;
+    int ret;
+
+    if (_Reader_drop_reservation(self) < 0 ||
+        _Reader_check_between_replies(self, "gets_raw") < 0)
+        return NULL;
+
+    ret = _Reader_scan_raw(self, &size);
+    if (ret == -1)
+        return NULL;
+    if (ret == 0) {
+        Py_INCREF(self->notEnoughDataObject);
+        return self->notEnoughDataObject;
+    }
+
+    obj = PyBytes_FromStringAndSize(r->buf + r->pos, size);
+    if (obj == NULL)
+        return NULL;
+    _Reader_consume(self, size);
+    if (self->stats != NULL)
+        self->stats->replies++;
+    return obj;
+}
+
+/* Parses the integer reply at p. Returns its size, or 0 when there is no
+ * complete and well formed integer reply at p. Anything else is left for
+ * the reader to handle. */
+static size_t _Reader_peek_integer(const char *p, const char *end, long long *value) {
+    const char *start = p;
+    unsigned long long v = 0, limit;
+    int negative = 0, digits = 0;
+
+    if (p == end || *p++ != ':')
+        return 0;
+    if (p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+
+    limit = negative ? (unsigned long long)LLONG_MAX + 1 : LLONG_MAX;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        if (v > (limit - (*p - '0')) / 10)
+            return 0;
+        v = v * 10 + (*p - '0');
+    }
+
+    if (digits == 0 || end - p < 2 || p[0] != '\r' || p[1] != '\n')
+        return 0;
+
+    *value = negative ? (long long)(0 - v) : (long long)v;
+    return p + 2 - start;
+}
+
+/* Raises err, an error created by the replyError or protocolError callable.
+ * Those may return any object, which #gets hands out as is, so fallback is
+ * raised with msg when err isn't an exception. Steals err. */
+static void _Reader_raise_created(PyObject *err, PyObject *fallback, PyObject *msg) {
+    if (err == NULL)
+        return;
+    if (PyExceptionInstance_Check(err))
+        PyErr_SetObject((PyObject *)Py_TYPE(err), err);
+    else
+        PyErr_SetObject(fallback, msg);
+    Py_DECREF(err);
+}
+
+/* Raises a protocol error for a reply that #gets_ints or #expect_ok can't
+ * read. */
+static void _Reader_raise_unexpected(libvalkey_ReaderObject *self, const char *format, ...) {
+    PyObject *msg, *err;
+    va_list vargs;
+
+    va_start(vargs, format);
+    msg = PyUnicode_FromFormatV(format, vargs);
+    va_end(vargs);
+    if (msg == NULL)
+        return;
+
+    /* protocolErrorClass might be a callable. */
+    err = PyObject_CallFunctionObjArgs(self->protocolErrorClass, msg, NULL);
+    _Reader_raise_created(err, self->state->VkErr_ProtocolError, msg);
+    Py_DECREF(msg);
+}
+
+/* Handles the reply at the read position when it isn't one that #gets_ints
+ * or #expect_ok read themselves. Push replies go to the push handler when
+ * there is one, and 1 is returned. Error replies are consumed and raised.
+ * Other replies are left for #gets, but raised as protocol errors so that
+ * they can't be mistaken for replies that didn't arrive yet. Returns 0 when
+ * the reply didn't arrive in full yet and -1 with an exception set
+ * otherwise. */
+static int _Reader_read_other(libvalkey_ReaderObject *self, const char *expected) {
+    valkeyReader *r = self->reader;
+    const char *p = r->buf + r->pos, *end = r->buf + r->len, *eol;
+    PyObject *msg, *err, *obj;
+    size_t size;
+    int push, ret;
+
+    if (*p == '>' && self->pushHandler != NULL) {
+        /* Only parse the push once it is complete, which leaves the reader
+         * in between replies afterwards. */
+        ret = _Reader_scan_raw(self, &size);
+        if (ret <= 0)
+            return ret;
+
+        self->shouldDecode = 1;
+        ret = _Reader_read_one(self, &obj, &push);
+        if (ret < 0)
+            return -1;
+        assert(ret == 1 && push);
+        return _Reader_call_push_handler(self, obj) < 0 ? -1 : 1;
+    }
+
+    if (*p != '+' && *p != '-') {
+        _Reader_raise_unexpected(self, "expected %s, got a reply of type '%c'", expected, *p);
+        return -1;
+    }
+
+    eol = memchr(p, '\r', end - p);
+    if (eol == NULL || (*p == '-' && (eol + 1 >= end || eol[1] != '\n')))
+        return 0;
+
+    msg = PyUnicode_DecodeUTF8(p + 1, eol - p - 1, "replace");
+    if (msg == NULL)
+        return -1;
+
+    if (*p == '+') {
+        _Reader_raise_unexpected(self, "expected %s, got %R", expected, msg);
+        Py_DECREF(msg);
+        return -1;
+    }
+
+    err = PyObject_CallFunctionObjArgs(self->replyErrorClass, msg, NULL);
+    _Reader_consume(self, eol + 2 - p);
+    if (self->stats != NULL) {
+        self->stats->replies++;
+        self->stats->elements[VALKEY_REPLY_ERROR]++;
+    }
+    _Reader_raise_created(err, self->state->VkErr_ReplyError, msg);
+    Py_DECREF(msg);
+    return -1;
+}
+
+/* Restores an exception fetched by #gets_ints or #expect_ok with what the
+ * call read before the reply it raised for as its result attribute. Steals
+ * all arguments. */
+static void _Reader_restore_with_result(PyObject *type, PyObject *value,
+                                        PyObject *traceback, PyObject *result) {
+    PyErr_NormalizeException(&type, &value, &traceback);
+    if (result == NULL || PyObject_SetAttrString(value, "result", result) < 0)
+        PyErr_Clear();
+    Py_XDECREF(result);
+    PyErr_Restore(type, value, traceback);
+}
+
+static PyObject *Reader_gets_ints(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "max", NULL };
+    valkeyReader *r = self->reader;
+    PyObject *maxObj = Py_None;
+    PyObject *data, *result, *type = NULL, *value = NULL, *traceback = NULL;
+    Py_ssize_t max, n = 0, cap = 0;
+    long long *values = NULL, *grown;
+    const char *p, *end;
+    size_t size;
+    int ret = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &maxObj))
+        return NULL;
+
+    if (_Reader_parse_max(maxObj, &max) < 0)
+        return NULL;
+
+    if (_Reader_drop_reservation(self) < 0 ||
+        _Reader_check_between_replies(self, "gets_ints") < 0)
+        return NULL;
+
+    while (n < max) {
+        if (n == cap) {
+            cap = cap > 0 ? cap * 2 : 64;
+            grown = PyMem_Realloc(values, cap * sizeof(*values));
+            if (grown == NULL) {
+                PyMem_Free(values);
+                return PyErr_NoMemory();
+            }
+            values = grown;
+        }
+
+        p = r->buf + r->pos;
+        end = r->buf + r->len;
+        if (p == end)
+            break;
+
+        size = _Reader_peek_integer(p, end, &values[n]);
+        if (size > 0) {
+            _Reader_consume(self, size);
+            n++;
+            continue;
+        }
+
+        if (*p == ':') {
+            /* Wait for the rest of the integer, but don't skip over one
+             * that the reader would raise for. */
+            if (memchr(p, '\n', end - p) == NULL)
+                break;
+            _Reader_raise_unexpected(self, "expected an integer, got an invalid integer reply");
+            ret = -1;
+            break;
+        }
+
+        ret = _Reader_read_other(self, "an integer");
+        if (ret <= 0)
+            break;
+    }
+
+    if (self->stats != NULL) {
+        self->stats->replies += n;
+        self->stats->elements[VALKEY_REPLY_INTEGER] += n;
+    }
+
+    if (ret < 0)
+        PyErr_Fetch(&type, &value, &traceback);
+
+    data = PyBytes_FromStringAndSize((const char *)values, n * sizeof(*values));
+    PyMem_Free(values);
+    result = data != NULL ? createArray(self->state, "q", data) : NULL;
+    Py_XDECREF(data);
+
+    if (ret < 0) {
+        _Reader_restore_with_result(type, value, traceback, result);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject *Reader_expect_ok(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "max", NULL };
+    valkeyReader *r = self->reader;
+    PyObject *maxObj = Py_None;
+    PyObject *type, *value, *traceback;
+    Py_ssize_t max, n = 0;
+    const char *p, *end;
+    int ret = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &maxObj))
+        return NULL;
+
+    if (_Reader_parse_max(maxObj, &max) < 0)
+        return NULL;
+
+    if (_Reader_drop_reservation(self) < 0 ||
+        _Reader_check_between_replies(self, "expect_ok") < 0)
+        return NULL;
+
+    while (n < max) {
+        p = r->buf + r->pos;
+        end = r->buf + r->len;
+
+        if (end - p >= 5 && memcmp(p, "+OK\r\n", 5) == 0) {
+            _Reader_consume(self, 5);
+            n++;
+            continue;
+        }
+
+        if (p == end)
+            break;
+        /* Wait for the rest of what may be an OK. */
+        if (end - p < 5 && memcmp(p, "+OK\r\n", end - p) == 0)
+            break;
+
+        ret = _Reader_read_other(self, "OK");
+        if (ret <= 0)
+            break;
+    }
+
+    if (self->stats != NULL) {
+        self->stats->replies += n;
+        self->stats->elements[VALKEY_REPLY_STATUS] += n;
+    }
+
+    if (ret < 0) {
+        PyErr_Fetch(&type, &value, &traceback);
+        _Reader_restore_with_result(type, value, traceback, PyLong_FromSsize_t(n));
+        return NULL;
+    }
+    return PyLong_FromSsize_t(n);
+}
+
+static PyObject *Reader_get_buffer(libvalkey_ReaderObject *self, PyObject *args) {
+    valkeyReader *r = self->reader;
+    Py_ssize_t sizehint = -1;
+    size_t size, avail, alloc;
+    PyObject *view;
+    sds buf, old;
+
+    if (!PyArg_ParseTuple(args, "|n", &sizehint))
+        return NULL;
+
+    if (r->err) {
+        _Reader_set_protocol_error(self);
+        return NULL;
+    }
+
+    _Reader_release_buffer_view(self);
+
+    /* Everything was read, start over at the beginning of the buffer. */
+    if (r->pos > 0 && r->pos == r->len) {
+        sdsclear(r->buf);
+        r->pos = r->len = 0;
+    }
+
+    size = sizehint > 0 ? (size_t)sizehint : READER_BUFFER_SIZE;
+    buf = old = r->buf;
+    alloc = sdsalloc(buf);
+    if (sdsavail(buf) < size ||
+        (r->len == 0 && r->maxbuf != 0 && sdsavail(buf) > r->maxbuf)) {
+        if (_Reader_check_buffer_exports(self) < 0)
+            return NULL;
+
+        /* Destroy internal buffer when it is empty and is quite large,
+         * the same way valkeyReaderFeed does. */
+        if (r->len == 0 && r->maxbuf != 0 && sdsavail(buf) > r->maxbuf) {
+            sdsfree(buf);
+            r->buf = buf = sdsempty();
+            r->pos = 0;
+            if (buf == NULL)
+                goto oom;
+        }
+
+        buf = sdsMakeRoomFor(buf, size);
+        if (buf == NULL)
+            goto oom;
+        r->buf = buf;
+        if (self->stats != NULL)
+            _Reader_track_buffer(self, old, alloc);
+    }
+
+    avail = sdsavail(buf);
+    self->bufferReserved = avail > INT_MAX ? INT_MAX : avail;
+
+    view = PyMemoryView_FromObject((PyObject*)self);
+    if (view == NULL) {
+        self->bufferReserved = 0;
+        return NULL;
+    }
+
+    Py_INCREF(view);
+    self->bufferView = view;
+    return view;
+
+oom:
+    self->bufferReserved = 0;
+    return PyErr_NoMemory();
+}
+
+/* Adds nbytes written to the view handed out by #get_buffer to the data in
+ * the buffer and releases the view. */
+static int _Reader_commit(libvalkey_ReaderObject *self, Py_ssize_t nbytes) {
+    if (nbytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "negative input");
+        return -1;
+    }
+
+    if ((size_t)nbytes > self->bufferReserved) {
+        PyErr_SetString(PyExc_ValueError,
+                        "input is larger than the reserved buffer size");
+        return -1;
+    }
+
+    if (nbytes > 0) {
+        sdsIncrLen(self->reader->buf, (int)nbytes);
+        self->reader->len = sdslen(self->reader->buf);
+        if (self->stats != NULL)
+            self->stats->bytesFed += nbytes;
+    }
+
+    _Reader_release_buffer_view(self);
+    return 0;
+}
+
+static PyObject *Reader_commit(libvalkey_ReaderObject *self, PyObject *arg) {
+    Py_ssize_t nbytes;
+
+    nbytes = PyLong_AsSsize_t(arg);
+    if (nbytes == -1 && PyErr_Occurred())
+        return NULL;
+
+    if (_Reader_commit(self, nbytes) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Commits nbytes like #commit, then reads replies for as long as there are
+ * waiters and hands each of them to the future popped off the left of the
+ * waiters deque. A reply that can't be converted is set as the exception of
+ * its future, any other error is raised. Futures that are already done, such
+ * as cancelled ones, lose their reply. Returns the number of replies read. */
+static PyObject *Reader_resolve(libvalkey_ReaderObject *self, PyObject *args) {
+    struct libvalkey_ModuleState *state = self->state;
+    PyObject *waiters, *reply, *waiter, *result, *type, *traceback;
+    Py_ssize_t nbytes = 0, size, resolved = 0;
+    int ret, done;
+
+    if (!PyArg_ParseTuple(args, "O|n", &waiters, &nbytes))
+        return NULL;
+
+    if (_Reader_commit(self, nbytes) < 0)
+        return NULL;
+
+    self->shouldDecode = 1;
+    for (;;) {
+        size = PyObject_Size(waiters);
+        if (size < 0)
+            return NULL;
+        if (size == 0)
+            break;
+
+        ret = _Reader_read_reply(self, &reply);
+        if (ret == 0)
+            break;
+        if (ret == -1)
+            return NULL;
+
+        if (ret == -2) {
+            PyErr_Fetch(&type, &reply, &traceback);
+            PyErr_NormalizeException(&type, &reply, &traceback);
+            if (traceback != NULL)
+                PyException_SetTraceback(reply, traceback);
+            Py_DECREF(type);
+            Py_XDECREF(traceback);
+        }
+
+        waiter = PyObject_CallMethodNoArgs(waiters, state->PopleftName);
+        if (waiter == NULL) {
+            Py_DECREF(reply);
+            return NULL;
+        }
+
+        result = PyObject_CallMethodNoArgs(waiter, state->DoneName);
+        done = result == NULL ? -1 : PyObject_IsTrue(result);
+        Py_XDECREF(result);
+        if (done == 0) {
+            result = PyObject_CallMethodOneArg(waiter,
+                    ret == -2 ? state->SetExceptionName : state->SetResultName, reply);
+            done = result == NULL ? -1 : 0;
+            Py_XDECREF(result);
+        }
+        Py_DECREF(waiter);
+        Py_DECREF(reply);
+        if (done < 0)
+            return NULL;
+        resolved++;
+    }
+
+    return PyLong_FromSsize_t(resolved);
+}
+
+static int _Reader_getbuffer(libvalkey_ReaderObject *self, Py_buffer *view, int flags) {
+    valkeyReader *r = self->reader;
+
+    if (_Reader_check_busy(self) < 0) {
+        view->obj = NULL;
+        return -1;
+    }
+
+    if (self->bufferReserved == 0) {
+        PyErr_SetString(PyExc_BufferError,
+                        "no buffer reserved, call get_buffer() first");
+        view->obj = NULL;
+        return -1;
+    }
+
+    if (PyBuffer_FillInfo(view, (PyObject*)self, r->buf + r->len,
+                          (Py_ssize_t)self->bufferReserved, 0, flags) < 0)
+        return -1;
+
+    self->bufferExports++;
+    return 0;
+}
+
+static int Reader_getbuffer(libvalkey_ReaderObject *self, Py_buffer *view, int flags) {
+    int result;
+    Py_BEGIN_CRITICAL_SECTION(self);
+    result = _Reader_getbuffer(self, view, flags);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+static void Reader_releasebuffer(libvalkey_ReaderObject *self, Py_buffer *view) {
+    Py_BEGIN_CRITICAL_SECTION(self);
+    self->bufferExports--;
+    Py_END_CRITICAL_SECTION();
+}
+
+static PyObject *Reader_setmaxbuf(libvalkey_ReaderObject *self, PyObject *arg) {
+    long maxbuf;
+
+    if (arg == Py_None)
+        maxbuf = VALKEY_READER_MAX_BUF;
+    else {
+        maxbuf = PyLong_AsLong(arg);
+        if (maxbuf < 0) {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_ValueError,
+                                "maxbuf value out of range");
+            return NULL;
+        }
+    }
+    self->reader->maxbuf = maxbuf;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *Reader_getmaxbuf(libvalkey_ReaderObject *self, PyObject *unused) {
+    return PyLong_FromSize_t(self->reader->maxbuf);
+}
+
+static PyObject *Reader_len(libvalkey_ReaderObject *self, PyObject *unused) {
+    return PyLong_FromSize_t(self->reader->len);
+}
+
+static PyObject *Reader_has_data(libvalkey_ReaderObject *self, PyObject *unused) {
+    if(self->reader->pos < self->reader->len)
+        Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+static PyObject *Reader_set_encoding(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "encoding", "errors", NULL };
+    char *encoding = NULL;
+    char *errors = NULL;
 
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "|zz", kwlist, &encoding, &errors))
         return NULL;
@@ -503,9 +2320,127 @@ static PyObject *Reader_set_encoding(libvalkey_ReaderObject *self, PyObject *arg
 
 }
 
+static PyObject *Reader_set_push_handler(libvalkey_ReaderObject *self, PyObject *arg) {
+    if (arg != Py_None && !PyCallable_Check(arg)) {
+        PyErr_SetString(PyExc_TypeError, "Expected a callable or None");
+        return NULL;
+    }
+
+    if (arg == Py_None)
+        arg = NULL;
+    Py_XINCREF(arg);
+    Py_XSETREF(self->pushHandler, arg);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Reader_set_stream_handler(libvalkey_ReaderObject *self, PyObject *arg) {
+    if (arg != Py_None && !PyCallable_Check(arg)) {
+        PyErr_SetString(PyExc_TypeError, "Expected a callable or None");
+        return NULL;
+    }
+
+    if (arg == Py_None)
+        arg = NULL;
+    Py_XINCREF(arg);
+    Py_XSETREF(self->streamHandler, arg);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Reader_reset(libvalkey_ReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "keep", NULL };
+    valkeyReader *r = self->reader;
+    PyObject *keepObj = Py_None;
+    Py_ssize_t keep;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &keepObj))
+        return NULL;
+
+    /* By default the buffer is kept when feed() would keep it. */
+    if (keepObj == Py_None) {
+        keep = r->maxbuf != 0 && r->maxbuf < PY_SSIZE_T_MAX ? (Py_ssize_t)r->maxbuf
+                                                             : PY_SSIZE_T_MAX;
+    } else {
+        keep = PyLong_AsSsize_t(keepObj);
+        if (keep == -1 && PyErr_Occurred())
+            return NULL;
+        if (keep < 0) {
+            PyErr_SetString(PyExc_ValueError, "keep must not be negative");
+            return NULL;
+        }
+    }
+
+    _Reader_release_buffer_view(self);
+    if (_Reader_check_buffer_exports(self) < 0)
+        return NULL;
+
+    /* Drop the part of a reply that was read so far. */
+    if (r->reply != NULL) {
+        r->fn->freeObject(r->reply);
+        r->reply = NULL;
+    }
+    r->ridx = -1;
+    r->err = 0;
+    r->errstr[0] = '\0';
+
+    /* The reader frees its buffer on errors. */
+    if (r->buf != NULL && sdsalloc(r->buf) > (size_t)keep) {
+        sdsfree(r->buf);
+        r->buf = NULL;
+    }
+    if (r->buf == NULL)
+        r->buf = sdsempty();
+    else
+        sdsclear(r->buf);
+    r->pos = r->len = 0;
+
+    Py_CLEAR(self->pendingObject);
+    Py_CLEAR(self->replyTransform);
+    Py_CLEAR(self->transformDiscard);
+    self->replyElements = 0;
+    Py_CLEAR(self->error.ptype);
+    Py_CLEAR(self->error.pvalue);
+    Py_CLEAR(self->error.ptraceback);
+    self->pushReply = 0;
+    self->rawScanned = 0;
+    self->streaming = 0;
+    Parse_Reset(&self->parser);
+
+    if (r->buf == NULL) {
+        r->err = VALKEY_ERR_OOM;
+        strcpy(r->errstr, "Out of memory");
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *Reader_stats(libvalkey_ReaderObject *self, PyObject *unused) {
+    if (self->stats == NULL)
+        Py_RETURN_NONE;
+    return Stats_ToDict(self->stats, self->reader->maxbuf);
+}
+
+static PyObject *Reader_reset_stats(libvalkey_ReaderObject *self, PyObject *unused) {
+    if (self->stats != NULL) {
+        Stats_Clear(self->stats);
+        _Reader_track_buffer(self, NULL, 0);
+    }
+    Py_RETURN_NONE;
+}
+
 static PyObject *Reader_convertSetsToLists(PyObject *obj, void *closure) {
     libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)obj;
     PyObject *result = PyBool_FromLong(self->convertSetsToLists);
     Py_INCREF(result);
     return result;
 }
+
+static PyObject *Reader_pushHandler(PyObject *obj, void *closure) {
+    libvalkey_ReaderObject *self = (libvalkey_ReaderObject*)obj;
+    PyObject *result;
+
+    Py_BEGIN_CRITICAL_SECTION(obj);
+    result = self->pushHandler != NULL ? self->pushHandler : Py_None;
+    Py_INCREF(result);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
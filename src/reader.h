@@ -2,21 +2,93 @@
 #define __READER_H
 
 #include "valkey/valkey.h"
+#include "libvalkey.h"
+#include "intern.h"
+#include "parse.h"
+#include "stats.h"
+#include "transform.h"
 #include <Python.h>
 
+/* A reader may be shared between threads. Its methods run in a critical
+ * section on the reader, so on free-threaded builds only one thread uses
+ * it at a time. */
 typedef struct {
     PyObject_HEAD
+    struct libvalkey_ModuleState *state;
     valkeyReader *reader;
     char *encoding;
     char *errors;
     int shouldDecode;
+    int decoder;
     PyObject *protocolErrorClass;
     PyObject *replyErrorClass;
     PyObject *notEnoughDataObject;
     int convertSetsToLists;
+    int lazy;
+    /* Callable that top-level push replies are passed to instead of being
+     * returned, and whether the reply being read is such a push. */
+    PyObject *pushHandler;
+    int pushReply;
+
+    /* Callable that top-level bulk strings of at least streamThreshold bytes
+     * are passed to in chunks as they arrive, whether such a string is being
+     * streamed, its size and the bytes of it that are still missing. */
+    PyObject *streamHandler;
+    size_t streamThreshold;
+    int streaming;
+    size_t streamSize;
+    size_t streamRemaining;
+
+    /* ReplyTransform passed to the current call, the one the reply being
+     * read was started with, the field of its next value and an element of
+     * it that is dropped once it is complete. */
+    PyObject *transform;
+    PyObject *replyTransform;
+    Py_ssize_t transformField;
+    PyObject *transformDiscard;
+
+    /* Map keys shared between replies, NULL when disabled. */
+    libvalkey_InternCache *internCache;
 
     PyObject *pendingObject;
 
+    /* Writable view of the free space at the end of the reader's buffer
+     * handed out by #get_buffer, and the number of bytes it spans until it
+     * is committed. The buffer can't move while views of it exist. */
+    PyObject *bufferView;
+    size_t bufferReserved;
+    Py_ssize_t bufferExports;
+
+    /* Progress of #gets_raw through an incomplete reply: bytes scanned so far
+     * and elements still missing. */
+    size_t rawScanned;
+    long long rawPending;
+
+    /* Size from which aggregates are parsed with the GIL released, 0 when
+     * disabled, whether that is happening right now and the progress
+     * through an incomplete reply. */
+    size_t releaseGilThreshold;
+    int busy;
+    libvalkey_Parser parser;
+
+    /* Whether flat numeric and bulk string aggregates are returned as
+     * arrays instead of lists. */
+    int columnar;
+
+    /* Number of elements from which automatic garbage collection is paused
+     * while a reply is built, 0 when disabled, the elements of the reply
+     * being built and whether collection is paused right now. */
+    size_t gcThreshold;
+    size_t replyElements;
+    int gcPaused;
+
+    /* Whether lists and sets are left to the garbage collector only once
+     * they hold objects that are tracked by it. */
+    int untrackReplies;
+
+    /* Counters for #stats, NULL when disabled. */
+    libvalkey_ReaderStats *stats;
+
     /* Stores error object in between incomplete calls to #gets, in order to
      * only set the error once a full reply has been read. Otherwise, the
      * reader could get in an inconsistent state. */
@@ -27,7 +99,7 @@ typedef struct {
     } error;
 } libvalkey_ReaderObject;
 
-extern PyTypeObject libvalkey_ReaderType;
+extern PyType_Spec libvalkey_ReaderSpec;
 extern valkeyReplyObjectFunctions libvalkey_ObjectFunctions;
 
 #endif
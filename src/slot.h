@@ -0,0 +1,13 @@
+#ifndef __SLOT_H
+#define __SLOT_H
+
+#include <stddef.h>
+
+/* Number of hash slots of a Valkey cluster. */
+#define SLOT_COUNT 16384
+
+/* Returns the cluster hash slot of a key. When the key contains a non-empty
+ * hash tag between the first '{' and the next '}', only the tag is hashed. */
+int Slot_Compute(const char *key, size_t len);
+
+#endif
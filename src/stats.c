@@ -0,0 +1,91 @@
+#include "stats.h"
+
+#include <string.h>
+#include <valkey/read.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static const char *stats_types[16] = {
+    [VALKEY_REPLY_STRING] = "string",
+    [VALKEY_REPLY_ARRAY] = "array",
+    [VALKEY_REPLY_INTEGER] = "integer",
+    [VALKEY_REPLY_NIL] = "nil",
+    [VALKEY_REPLY_STATUS] = "status",
+    [VALKEY_REPLY_ERROR] = "error",
+    [VALKEY_REPLY_DOUBLE] = "double",
+    [VALKEY_REPLY_BOOL] = "bool",
+    [VALKEY_REPLY_MAP] = "map",
+    [VALKEY_REPLY_SET] = "set",
+    [VALKEY_REPLY_ATTR] = "attr",
+    [VALKEY_REPLY_PUSH] = "push",
+    [VALKEY_REPLY_BIGNUM] = "bignum",
+    [VALKEY_REPLY_VERB] = "verb",
+};
+
+libvalkey_ReaderStats *Stats_New(void) {
+    return PyMem_Calloc(1, sizeof(libvalkey_ReaderStats));
+}
+
+void Stats_Free(libvalkey_ReaderStats *stats) {
+    PyMem_Free(stats);
+}
+
+void Stats_Clear(libvalkey_ReaderStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+/* Monotonic time in nanoseconds. */
+unsigned long long Stats_Now(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)(counter.QuadPart / frequency.QuadPart * 1000000000ULL +
+                                counter.QuadPart % frequency.QuadPart * 1000000000ULL /
+                                frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+PyObject *Stats_ToDict(const libvalkey_ReaderStats *stats, size_t maxbuf) {
+    PyObject *elements, *count;
+    int i;
+
+    elements = PyDict_New();
+    if (elements == NULL)
+        return NULL;
+
+    for (i = 0; i < 16; i++) {
+        if (stats_types[i] == NULL)
+            continue;
+        count = PyLong_FromUnsignedLongLong(stats->elements[i]);
+        if (count == NULL || PyDict_SetItemString(elements, stats_types[i], count) < 0) {
+            Py_XDECREF(count);
+            Py_DECREF(elements);
+            return NULL;
+        }
+        Py_DECREF(count);
+    }
+
+    return Py_BuildValue("{sKsKsNsKsnsnsKsKsK}",
+                         "bytes_fed", stats->bytesFed,
+                         "replies", stats->replies,
+                         "elements", elements,
+                         "buffer_reallocations", stats->bufferReallocations,
+                         "buffer_peak", (Py_ssize_t)stats->bufferPeak,
+                         "maxbuf", (Py_ssize_t)maxbuf,
+                         "decode_errors", stats->decodeErrors,
+                         "parse_ns", stats->parseNs,
+                         "gc_pauses", stats->gcPauses);
+}
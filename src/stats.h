@@ -0,0 +1,27 @@
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <Python.h>
+
+/* Counters of a reader, which only exist when it was created with
+ * stats=True. Elements are counted by their VALKEY_REPLY_* type. */
+typedef struct {
+    unsigned long long bytesFed;
+    unsigned long long replies;
+    unsigned long long elements[16];
+    unsigned long long bufferReallocations;
+    size_t bufferPeak;
+    unsigned long long decodeErrors;
+    unsigned long long parseNs;
+    unsigned long long gcPauses;
+} libvalkey_ReaderStats;
+
+#define STATS_COUNT_ELEMENT(stats, type) ((stats)->elements[(type) & 15]++)
+
+libvalkey_ReaderStats *Stats_New(void);
+void Stats_Free(libvalkey_ReaderStats *stats);
+void Stats_Clear(libvalkey_ReaderStats *stats);
+PyObject *Stats_ToDict(const libvalkey_ReaderStats *stats, size_t maxbuf);
+unsigned long long Stats_Now(void);
+
+#endif
@@ -0,0 +1,77 @@
+#include "streamed.h"
+#include "libvalkey.h"
+
+PyObject *StreamedReply_New(PyTypeObject *type, Py_ssize_t size) {
+    libvalkey_StreamedReplyObject *self;
+
+    self = (libvalkey_StreamedReplyObject*)type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+    self->size = size;
+    return (PyObject*)self;
+}
+
+static PyObject *StreamedReply_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "size", NULL };
+    Py_ssize_t size;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n", kwlist, &size))
+        return NULL;
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "size must not be negative");
+        return NULL;
+    }
+    return StreamedReply_New(type, size);
+}
+
+static void StreamedReply_dealloc(libvalkey_StreamedReplyObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+
+    type->tp_free((PyObject*)self);
+    Py_DECREF(type);
+}
+
+static PyObject *StreamedReply_repr(libvalkey_StreamedReplyObject *self) {
+    return PyUnicode_FromFormat("StreamedReply(size=%zd)", self->size);
+}
+
+static PyObject *StreamedReply_richcompare(libvalkey_StreamedReplyObject *self, PyObject *other,
+                                           int op) {
+    if (!PyObject_TypeCheck(other, Py_TYPE(self)) || (op != Py_EQ && op != Py_NE))
+        Py_RETURN_NOTIMPLEMENTED;
+    Py_RETURN_RICHCOMPARE(self->size, ((libvalkey_StreamedReplyObject*)other)->size, op);
+}
+
+static Py_hash_t StreamedReply_hash(libvalkey_StreamedReplyObject *self) {
+    return (Py_hash_t)self->size;
+}
+
+static PyObject *StreamedReply_get_size(libvalkey_StreamedReplyObject *self, void *closure) {
+    return PyLong_FromSsize_t(self->size);
+}
+
+static PyGetSetDef StreamedReply_getset[] = {
+    {"size", (getter)StreamedReply_get_size, NULL, "Number of bytes passed to the handler", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyType_Slot StreamedReply_slots[] = {
+    {Py_tp_dealloc, (void *)StreamedReply_dealloc},
+    {Py_tp_repr, (void *)StreamedReply_repr},
+    {Py_tp_richcompare, (void *)StreamedReply_richcompare},
+    {Py_tp_hash, (void *)StreamedReply_hash},
+    {Py_tp_getset, StreamedReply_getset},
+    {Py_tp_new, (void *)StreamedReply_new},
+    {Py_tp_doc, (void *)"StreamedReply(size)\n\n"
+                        "Reply that gets() returns for a bulk string of size bytes that was\n"
+                        "passed to the stream handler"},
+    {0, NULL},
+};
+
+PyType_Spec libvalkey_StreamedReplySpec = {
+    MOD_LIBVALKEY ".StreamedReply",
+    sizeof(libvalkey_StreamedReplyObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    StreamedReply_slots,
+};
@@ -0,0 +1,17 @@
+#ifndef __STREAMED_H
+#define __STREAMED_H
+
+#include <Python.h>
+
+/* Reply that stands in for a bulk string that was passed to the stream
+ * handler instead of being returned. */
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t size;
+} libvalkey_StreamedReplyObject;
+
+extern PyType_Spec libvalkey_StreamedReplySpec;
+
+PyObject *StreamedReply_New(PyTypeObject *type, Py_ssize_t size);
+
+#endif
@@ -0,0 +1,227 @@
+#include "transform.h"
+#include "libvalkey.h"
+
+#include <string.h>
+
+static const char *transform_kinds[] = {
+    [TRANSFORM_DICT] = "dict",
+    [TRANSFORM_PAIRS] = "pairs",
+    [TRANSFORM_FIELDS] = "fields",
+};
+
+/* Converts the type a field is declared with to its conversion. */
+static int transform_conversion(PyObject *type) {
+    if (type == Py_None)
+        return TRANSFORM_AS_IS;
+    if (type == (PyObject*)&PyBytes_Type)
+        return TRANSFORM_BYTES;
+    if (type == (PyObject*)&PyUnicode_Type)
+        return TRANSFORM_STR;
+    if (type == (PyObject*)&PyLong_Type)
+        return TRANSFORM_INT;
+    if (type == (PyObject*)&PyFloat_Type)
+        return TRANSFORM_FLOAT;
+
+    PyErr_Format(PyExc_TypeError,
+                 "field types must be None, bytes, str, int or float, not %R", type);
+    return -1;
+}
+
+/* Sets up the fields from a sequence of names, or a dict of names to
+ * types. */
+static int transform_set_fields(libvalkey_TransformObject *self, PyObject *fields) {
+    PyObject *names, *name, *encoded, *type;
+    Py_ssize_t i, n;
+
+    names = PyDict_Check(fields) ? PyDict_Keys(fields) : PySequence_List(fields);
+    if (names == NULL)
+        return -1;
+
+    n = PyList_GET_SIZE(names);
+    self->names = PyTuple_New(n);
+    self->conversions = PyMem_Calloc(n > 0 ? n : 1, sizeof(int));
+    if (self->names == NULL || self->conversions == NULL) {
+        Py_DECREF(names);
+        if (self->conversions == NULL)
+            PyErr_NoMemory();
+        return -1;
+    }
+    self->nfields = n;
+
+    for (i = 0; i < n; i++) {
+        name = PyList_GET_ITEM(names, i);
+        if (PyUnicode_Check(name)) {
+            encoded = PyUnicode_AsUTF8String(name);
+        } else if (PyBytes_Check(name)) {
+            encoded = name;
+            Py_INCREF(encoded);
+        } else {
+            PyErr_Format(PyExc_TypeError, "field names must be str or bytes, not %.100s",
+                         Py_TYPE(name)->tp_name);
+            encoded = NULL;
+        }
+        if (encoded == NULL)
+            break;
+        PyTuple_SET_ITEM(self->names, i, encoded);
+
+        if (PyDict_Check(fields)) {
+            type = PyDict_GetItemWithError(fields, name);
+            if (type == NULL)
+                break;
+            self->conversions[i] = transform_conversion(type);
+            if (self->conversions[i] < 0)
+                break;
+        }
+    }
+
+    Py_DECREF(names);
+    return i == n ? 0 : -1;
+}
+
+static PyObject *Transform_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { "kind", "fields", "factory", NULL };
+    libvalkey_TransformObject *self;
+    PyObject *fields = Py_None, *factory = Py_None;
+    const char *kind;
+    int i;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OO", kwlist, &kind, &fields, &factory))
+        return NULL;
+
+    for (i = 0; i < 3; i++)
+        if (strcmp(kind, transform_kinds[i]) == 0)
+            break;
+    if (i == 3) {
+        PyErr_Format(PyExc_ValueError,
+                     "kind must be 'dict', 'pairs' or 'fields', not '%s'", kind);
+        return NULL;
+    }
+
+    if (i == TRANSFORM_FIELDS && fields == Py_None) {
+        PyErr_SetString(PyExc_TypeError, "'fields' transforms need fields");
+        return NULL;
+    }
+    if (i != TRANSFORM_FIELDS && (fields != Py_None || factory != Py_None)) {
+        PyErr_SetString(PyExc_TypeError, "fields and factory only apply to 'fields' transforms");
+        return NULL;
+    }
+    if (factory != Py_None && !PyCallable_Check(factory)) {
+        PyErr_SetString(PyExc_TypeError, "factory must be callable");
+        return NULL;
+    }
+
+    self = (libvalkey_TransformObject*)type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+
+    self->kind = i;
+    self->nfields = 0;
+    self->names = NULL;
+    self->conversions = NULL;
+    self->factory = NULL;
+    if (factory != Py_None) {
+        Py_INCREF(factory);
+        self->factory = factory;
+    }
+
+    if (i == TRANSFORM_FIELDS && transform_set_fields(self, fields) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject*)self;
+}
+
+static int Transform_traverse(libvalkey_TransformObject *self, visitproc visit, void *arg) {
+    Py_VISIT(Py_TYPE(self));
+    Py_VISIT(self->factory);
+    return 0;
+}
+
+static int Transform_clear(libvalkey_TransformObject *self) {
+    Py_CLEAR(self->factory);
+    return 0;
+}
+
+static void Transform_dealloc(libvalkey_TransformObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+
+    PyObject_GC_UnTrack(self);
+    Transform_clear(self);
+    Py_XDECREF(self->names);
+    PyMem_Free(self->conversions);
+    type->tp_free((PyObject*)self);
+    Py_DECREF(type);
+}
+
+static PyObject *Transform_repr(libvalkey_TransformObject *self) {
+    return PyUnicode_FromFormat("ReplyTransform('%s')", transform_kinds[self->kind]);
+}
+
+/* Creates the empty reply for an aggregate of elements keys and values. */
+PyObject *Transform_NewReply(libvalkey_TransformObject *transform, Py_ssize_t elements) {
+    PyObject *reply;
+    Py_ssize_t i;
+
+    switch (transform->kind) {
+        case TRANSFORM_DICT:
+            return PyDict_New();
+        case TRANSFORM_PAIRS:
+            return PyList_New(elements / 2);
+        default:
+            reply = PyTuple_New(transform->nfields);
+            if (reply == NULL)
+                return NULL;
+            for (i = 0; i < transform->nfields; i++) {
+                Py_INCREF(Py_None);
+                PyTuple_SET_ITEM(reply, i, Py_None);
+            }
+            return reply;
+    }
+}
+
+/* Returns the index of the field named by the len bytes at str, or -1 when
+ * there is no such field. */
+Py_ssize_t Transform_FindField(libvalkey_TransformObject *transform, const char *str, size_t len) {
+    PyObject *name;
+    Py_ssize_t i;
+
+    for (i = 0; i < transform->nfields; i++) {
+        name = PyTuple_GET_ITEM(transform->names, i);
+        if ((size_t)PyBytes_GET_SIZE(name) == len && memcmp(PyBytes_AS_STRING(name), str, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Finishes a complete reply, which steals the reference to it. */
+PyObject *Transform_Finish(libvalkey_TransformObject *transform, PyObject *reply) {
+    PyObject *result;
+
+    if (transform->factory == NULL)
+        return reply;
+
+    result = PyObject_Call(transform->factory, reply, NULL);
+    Py_DECREF(reply);
+    return result;
+}
+
+static PyType_Slot Transform_slots[] = {
+    {Py_tp_dealloc, (void *)Transform_dealloc},
+    {Py_tp_traverse, (void *)Transform_traverse},
+    {Py_tp_clear, (void *)Transform_clear},
+    {Py_tp_repr, (void *)Transform_repr},
+    {Py_tp_new, (void *)Transform_new},
+    {Py_tp_doc, (void *)"ReplyTransform(kind, fields=None, factory=None)\n\n"
+                        "Shape that gets() creates replies of key-value pairs in: 'dict',\n"
+                        "'pairs' for a list of tuples, or 'fields' for a tuple of the values\n"
+                        "of the given fields, which factory is called with"},
+    {0, NULL},
+};
+
+PyType_Spec libvalkey_ReplyTransformSpec = {
+    MOD_LIBVALKEY ".ReplyTransform",
+    sizeof(libvalkey_TransformObject),
+    0,
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    Transform_slots,
+};
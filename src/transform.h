@@ -0,0 +1,41 @@
+#ifndef __TRANSFORM_H
+#define __TRANSFORM_H
+
+#include <Python.h>
+
+/* Shapes a reply of key-value pairs can be created in. */
+enum {
+    TRANSFORM_DICT,
+    TRANSFORM_PAIRS,
+    TRANSFORM_FIELDS,
+};
+
+/* Conversions of the string values of fields. */
+enum {
+    TRANSFORM_AS_IS,
+    TRANSFORM_BYTES,
+    TRANSFORM_STR,
+    TRANSFORM_INT,
+    TRANSFORM_FLOAT,
+};
+
+/* Shape that a flat array or map reply of key-value pairs is created in
+ * instead of a list. TRANSFORM_FIELDS puts the values of the named fields
+ * in a tuple in their order, converted with their conversion, and calls the
+ * factory with them when there is one. */
+typedef struct {
+    PyObject_HEAD
+    int kind;
+    Py_ssize_t nfields;
+    PyObject *names;    /* tuple of bytes */
+    int *conversions;
+    PyObject *factory;
+} libvalkey_TransformObject;
+
+extern PyType_Spec libvalkey_ReplyTransformSpec;
+
+PyObject *Transform_NewReply(libvalkey_TransformObject *transform, Py_ssize_t elements);
+Py_ssize_t Transform_FindField(libvalkey_TransformObject *transform, const char *str, size_t len);
+PyObject *Transform_Finish(libvalkey_TransformObject *transform, PyObject *reply);
+
+#endif
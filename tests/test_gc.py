@@ -17,3 +17,125 @@ def test_reader_gc():
     assert not any(
         isinstance(o, A) for o in gc.get_objects()
     ), "Referent was not collected"
+
+
+def collections_during_gets(reader, data):
+    collections = []
+
+    def callback(phase, info):
+        if phase == "start":
+            collections.append(info)
+
+    threshold = gc.get_threshold()
+    gc.callbacks.append(callback)
+    gc.set_threshold(1)
+    try:
+        reader.feed(data)
+        reply = reader.gets()
+    finally:
+        gc.set_threshold(*threshold)
+        gc.callbacks.remove(callback)
+    return reply, len(collections)
+
+
+def test_gc_threshold():
+    data = b"*100\r\n" + b"*1\r\n:1\r\n" * 100
+    reply, collections = collections_during_gets(libvalkey.Reader(), data)
+    assert 100 == len(reply)
+    assert collections > 0
+
+    reader = libvalkey.Reader(gcThreshold=3, stats=True)
+    reply, collections = collections_during_gets(reader, data)
+    assert 100 == len(reply)
+    assert 0 == collections
+    assert gc.isenabled()
+    assert 1 == reader.stats()["gc_pauses"]
+
+    # Replies that arrive in parts stay paused while they are built.
+    reader.feed(b"*3\r\n:1\r\n")
+    assert False is reader.gets()
+    assert gc.isenabled()
+    reply, collections = collections_during_gets(reader, b"*1\r\n:2\r\n*1\r\n:3\r\n")
+    assert [1, [2], [3]] == reply
+    assert 0 == collections
+    assert gc.isenabled()
+
+
+def test_gc_threshold_callbacks():
+    enabled = []
+
+    def reply_error(message):
+        enabled.append(gc.isenabled())
+        if message == "ERR disable":
+            gc.disable()
+        return Exception(message)
+
+    # Code called while a reply is read sees collection as it left it.
+    reader = libvalkey.Reader(replyError=reply_error, gcThreshold=3, stats=True)
+    reader.feed(b"*3\r\n-ERR a\r\n:1\r\n*1\r\n-ERR b\r\n")
+    assert 3 == len(reader.gets())
+    assert [True, True] == enabled
+    assert gc.isenabled()
+
+    # Collection stays disabled when the code disabled it.
+    try:
+        reader.feed(b"*3\r\n-ERR disable\r\n:1\r\n:2\r\n")
+        assert 3 == len(reader.gets())
+        assert not gc.isenabled()
+    finally:
+        gc.enable()
+
+
+def test_gc_threshold_nested_readers():
+    inner = libvalkey.Reader(gcThreshold=1)
+
+    def reply_error(message):
+        inner.feed(b"*2\r\n:1\r\n:2\r\n")
+        assert [1, 2] == inner.gets()
+        return Exception(message)
+
+    reader = libvalkey.Reader(replyError=reply_error, gcThreshold=1)
+    reader.feed(b"*2\r\n-ERR a\r\n*1\r\n:1\r\n")
+    assert 2 == len(reader.gets())
+    assert gc.isenabled()
+
+
+def test_gc_threshold_disabled_gc():
+    reader = libvalkey.Reader(gcThreshold=1)
+    gc.disable()
+    try:
+        reader.feed(b"*1\r\n:1\r\n")
+        assert [1] == reader.gets()
+        assert not gc.isenabled()
+    finally:
+        gc.enable()
+
+
+def test_untrack_replies():
+    reader = libvalkey.Reader(untrackReplies=True)
+    reader.feed(b"*2\r\n*1\r\n$3\r\nfoo\r\n~1\r\n:1\r\n")
+    reader.feed(b"*2\r\n:1\r\n*1\r\n-ERR x\r\n")
+    reply = reader.gets()
+    assert not gc.is_tracked(reply)
+    assert not any(gc.is_tracked(element) for element in reply)
+
+    # Containers that hold tracked objects, and all containers they are in,
+    # are tracked.
+    reply = reader.gets()
+    assert gc.is_tracked(reply)
+    assert gc.is_tracked(reply[1])
+
+    reader = libvalkey.Reader()
+    reader.feed(b"*1\r\n:1\r\n")
+    assert gc.is_tracked(reader.gets())
+
+
+def test_untrack_transform():
+    reader = libvalkey.Reader()
+    reader.feed(b"*4\r\n$1\r\na\r\n:1\r\n$1\r\nb\r\n*0\r\n" * 2)
+    reply = reader.gets(transform=libvalkey.ReplyTransform("pairs"))
+    assert not gc.is_tracked(reply[0])
+    assert gc.is_tracked(reply[1])
+    reply = reader.gets(transform=libvalkey.ReplyTransform("fields", ["a", "b"]))
+    assert (1, []) == reply
+    assert gc.is_tracked(reply)
@@ -1,3 +1,6 @@
+import array
+import enum
+
 import pytest
 
 import libvalkey
@@ -79,3 +82,234 @@ def test_wrong_type():
 
     with pytest.raises(TypeError):
         libvalkey.pack_command(("HSET", "foo", Bar()))
+
+
+def test_many_args():
+    cmd = tuple(["RPUSH", "list"] + list(range(100)))
+    expected = b"*102\r\n$5\r\nRPUSH\r\n$4\r\nlist\r\n" + b"".join(
+        b"$%d\r\n%d\r\n" % (len(str(i)), i) for i in range(100)
+    )
+    assert libvalkey.pack_command(cmd) == expected
+
+
+@pytest.mark.parametrize("cmd,expected_packed_cmd", testdata, ids=testdata_ids)
+def test_pack_into(cmd, expected_packed_cmd):
+    buffer = bytearray(b"x" * (len(expected_packed_cmd) + 5))
+    assert libvalkey.pack_into(buffer, 2, *cmd) == len(expected_packed_cmd)
+    assert buffer == b"xx" + expected_packed_cmd + b"xxx"
+
+
+def test_pack_into_memoryview():
+    buffer = bytearray(32)
+    written = libvalkey.pack_into(memoryview(buffer)[4:], 0, "GET", "a")
+    assert bytes(buffer[4 : 4 + written]) == b"*2\r\n$3\r\nGET\r\n$1\r\na\r\n"
+
+
+def test_pack_into_too_small():
+    buffer = bytearray(10)
+    with pytest.raises(ValueError):
+        libvalkey.pack_into(buffer, 0, "GET", "a")
+    with pytest.raises(ValueError):
+        libvalkey.pack_into(bytearray(100), 95, "GET", "a")
+    with pytest.raises(ValueError):
+        libvalkey.pack_into(bytearray(100), -1, "GET", "a")
+    assert buffer == bytearray(10)
+
+
+def test_pack_into_wrong_type():
+    with pytest.raises(BufferError):
+        libvalkey.pack_into(b"read only", 0, "GET", "a")
+    with pytest.raises(TypeError):
+        libvalkey.pack_into(bytearray(100), 0, "HSET", "foo", True)
+    with pytest.raises(TypeError):
+        libvalkey.pack_into(bytearray(100))
+
+
+def test_pack_pipeline():
+    commands = [cmd for cmd, _ in testdata]
+    expected = b"".join(packed for _, packed in testdata)
+    assert libvalkey.pack_pipeline(commands) == expected
+    assert libvalkey.pack_pipeline(tuple(commands)) == expected
+    assert libvalkey.pack_pipeline([]) == b""
+
+
+def test_pack_pipeline_wrong_type():
+    with pytest.raises(TypeError):
+        libvalkey.pack_pipeline([("GET", "a"), ["GET", "b"]])
+    with pytest.raises(TypeError):
+        libvalkey.pack_pipeline([("GET", "a"), ("HSET", "foo", True)])
+    with pytest.raises(TypeError):
+        libvalkey.pack_pipeline(None)
+
+
+@pytest.mark.parametrize("cmd,expected_packed_cmd", testdata, ids=testdata_ids)
+def test_pack_command_vectored(cmd, expected_packed_cmd):
+    for threshold in (0, 1, 4, 1024):
+        chunks = libvalkey.pack_command_vectored(cmd, threshold=threshold)
+        assert b"".join(chunks) == expected_packed_cmd
+
+
+def test_pack_command_vectored_references_large_args():
+    value = b"v" * 100
+    view = memoryview(b"w" * 100)
+    chunks = libvalkey.pack_command_vectored(
+        ("MSET", "a", value, "b", view, "c", "x" * 100), threshold=100
+    )
+    assert [b"*7\r\n$4\r\nMSET\r\n$1\r\na\r\n$100\r\n", value] == chunks[:2]
+    assert chunks[1].obj is value
+    assert chunks[3] is view
+    assert all(isinstance(chunk, bytes) for chunk in chunks[2::2])
+    assert len(chunks) == 5
+
+
+def test_pack_command_vectored_default_threshold():
+    chunks = libvalkey.pack_command_vectored(("SET", "a", b"v" * 100))
+    assert [libvalkey.pack_command(("SET", "a", b"v" * 100))] == chunks
+
+
+def test_pack_command_vectored_wrong_type():
+    with pytest.raises(TypeError):
+        libvalkey.pack_command_vectored(("HSET", "foo", True))
+    with pytest.raises(TypeError):
+        libvalkey.pack_command_vectored(["GET", "a"])
+    with pytest.raises(ValueError):
+        libvalkey.pack_command_vectored(("GET", "a"), threshold=-1)
+
+
+def test_pack_command_slot():
+    assert (12182, libvalkey.pack_command(("GET", "foo"))) == libvalkey.pack_command_slot(
+        ("GET", "foo")
+    )
+    assert 12739 == libvalkey.pack_command_slot(("GET", b"123456789"))[0]
+    assert 12182 == libvalkey.pack_command_slot(("EVALSHA", "sha", 1, "foo"), key_index=3)[0]
+
+
+def test_pack_command_slot_hash_tags():
+    def slot(key):
+        return libvalkey.pack_command_slot(("GET", key))[0]
+
+    assert slot("{user1000}.following") == slot("{user1000}.followers") == slot("user1000")
+    assert slot("foo{}{bar}") != slot("bar")
+    assert slot("foo{{bar}}zap") == slot("{bar")
+    assert slot("foo{bar}{zap}") == slot("bar")
+    assert slot("foo{bar") != slot("bar")
+
+
+def test_pack_command_slot_wrong_key_index():
+    with pytest.raises(IndexError):
+        libvalkey.pack_command_slot(("PING",))
+    with pytest.raises(ValueError):
+        libvalkey.pack_command_slot(("GET", "a"), key_index=-1)
+    with pytest.raises(TypeError):
+        libvalkey.pack_command_slot(["GET", "a"])
+
+
+def test_pack_pipeline_slots():
+    commands = [("SET", "foo", 1), ("GET", "bar"), ("GET", "{foo}x"), ("INCR", 1)]
+    slots, buffers = libvalkey.pack_pipeline_slots(commands)
+    expected = [libvalkey.pack_command_slot(cmd)[0] for cmd in commands]
+    assert expected == slots
+    assert {
+        12182: libvalkey.pack_pipeline([commands[0], commands[2]]),
+        5061: libvalkey.pack_pipeline([commands[1]]),
+        expected[3]: libvalkey.pack_pipeline([commands[3]]),
+    } == buffers
+    assert ([], {}) == libvalkey.pack_pipeline_slots([])
+
+
+def test_pack_pipeline_slots_wrong_type():
+    with pytest.raises(IndexError):
+        libvalkey.pack_pipeline_slots([("GET", "a"), ("PING",)])
+    with pytest.raises(TypeError):
+        libvalkey.pack_pipeline_slots([("GET", "a"), ("HSET", "foo", True)])
+    with pytest.raises(TypeError):
+        libvalkey.pack_pipeline_slots(None)
+
+
+def test_pack_command_integers():
+    cmd = ("A", 0, -1, -(2**63), 2**63 - 1, 2**70, -(2**64))
+    expected = b"*7\r\n" + b"".join(
+        b"$%d\r\n%s\r\n" % (len(arg), arg) for arg in [b"A"] + [str(n).encode() for n in cmd[1:]]
+    )
+    assert expected == libvalkey.pack_command(cmd)
+
+
+def packed(*args):
+    return b"*%d\r\n" % len(args) + b"".join(b"$%d\r\n%s\r\n" % (len(a), a) for a in args)
+
+
+def test_pack_command_buffers():
+    value = bytearray(b"value")
+    cmd = ("SET", value, array.array("B", b"arr"), memoryview(b"mv"))
+    assert packed(b"SET", b"value", b"arr", b"mv") == libvalkey.pack_command(cmd)
+    # The buffer isn't exported anymore once the command is packed.
+    value.extend(b"!")
+
+
+def test_pack_command_non_contiguous_buffer():
+    with pytest.raises(BufferError):
+        libvalkey.pack_command(("SET", "a", memoryview(b"abcd")[::2]))
+
+
+def test_pack_command_vectored_references_buffers():
+    value = bytearray(b"v" * 100)
+    chunks = libvalkey.pack_command_vectored(("SET", "a", value), threshold=100)
+    assert chunks[1].obj is value
+
+
+def test_pack_command_numeric_subclasses():
+    class Color(enum.IntEnum):
+        RED = 1
+
+    class Float(float):
+        def __repr__(self):
+            return "Float()"
+
+    class Int(int):
+        def __repr__(self):
+            return "Int()"
+
+    cmd = ("SET", Color.RED, Float(1.5), Int(2**70))
+    assert packed(b"SET", b"1", b"1.5", b"%d" % 2**70) == libvalkey.pack_command(cmd)
+
+
+def test_pack_command_floats():
+    values = [0.1, -0.0, 1e16, 1e-300, 2.0**0.5, float("inf"), float("-inf"), float("nan")]
+    expected = packed(b"A", *(repr(v).encode() for v in values))
+    assert expected == libvalkey.pack_command(("A", *values))
+
+
+def test_pack_command_bool():
+    for value in (True, False):
+        with pytest.raises(TypeError, match="bool"):
+            libvalkey.pack_command(("SET", "a", value))
+
+
+@pytest.mark.parametrize("cmd,expected_packed_cmd", testdata, ids=testdata_ids)
+def test_command_template(cmd, expected_packed_cmd):
+    variables = cmd[1::2]
+    template = libvalkey.CommandTemplate(*(None if i % 2 else arg for i, arg in enumerate(cmd)))
+    assert expected_packed_cmd == template.pack(*variables)
+    assert expected_packed_cmd * 2 == template.pack_many([variables, variables])
+
+
+def test_command_template_constants_only():
+    template = libvalkey.CommandTemplate("PING")
+    assert libvalkey.pack_command(("PING",)) == template.pack()
+    assert b"" == template.pack_many([])
+
+
+def test_command_template_wrong_arguments():
+    template = libvalkey.CommandTemplate("EXPIRE", None, None)
+    with pytest.raises(TypeError):
+        template.pack("key")
+    with pytest.raises(TypeError):
+        template.pack("key", True)
+    with pytest.raises(TypeError):
+        template.pack_many([("key", 1), ("key",)])
+    with pytest.raises(TypeError):
+        template.pack_many([["key", 1]])
+    with pytest.raises(TypeError):
+        libvalkey.CommandTemplate("GET", True)
+    with pytest.raises(TypeError):
+        libvalkey.CommandTemplate("GET", key=None)
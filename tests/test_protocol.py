@@ -0,0 +1,104 @@
+import asyncio
+
+import pytest
+
+import libvalkey
+from libvalkey.protocol import ReaderProtocol
+
+
+async def connect(replies, factory=ReaderProtocol):
+    """Connects to a server that answers every command with the next reply and
+    closes the connection after the last one."""
+    async def handle(reader, writer):
+        for reply in replies:
+            await reader.readuntil(b"\r\n")
+            writer.write(reply)
+        writer.close()
+
+    server = await asyncio.start_server(handle, "127.0.0.1", 0)
+    port = server.sockets[0].getsockname()[1]
+    loop = asyncio.get_running_loop()
+    _, protocol = await loop.create_connection(factory, "127.0.0.1", port)
+    return server, protocol
+
+
+def test_request():
+    async def main():
+        server, protocol = await connect([b"+PONG\r\n", b"$3\r\nbar\r\n"])
+        async with server:
+            assert b"PONG" == await protocol.request(b"PING\r\n")
+            assert b"bar" == await protocol.request(b"GET foo\r\n")
+
+    asyncio.run(main())
+
+
+def test_pipeline():
+    async def main():
+        replies = [b":%d\r\n" % i for i in range(100)]
+        server, protocol = await connect(replies)
+        async with server:
+            waiters = [protocol.request(b"INCR foo\r\n") for _ in replies]
+            assert list(range(100)) == await asyncio.gather(*waiters)
+
+    asyncio.run(main())
+
+
+def test_protocol_error_fails_waiters():
+    async def main():
+        server, protocol = await connect([b"x\r\n"])
+        async with server:
+            waiter = protocol.request(b"PING\r\n")
+            with pytest.raises(libvalkey.ProtocolError):
+                await waiter
+            with pytest.raises(libvalkey.ProtocolError):
+                protocol.request(b"PING\r\n")
+
+    asyncio.run(main())
+
+
+def test_connection_lost():
+    async def main():
+        server, protocol = await connect([])
+        async with server:
+            waiter = protocol.request(b"PING\r\n")
+            with pytest.raises(ConnectionError):
+                await waiter
+
+    asyncio.run(main())
+
+
+PUSH = b">3\r\n$7\r\nmessage\r\n$2\r\nch\r\n$2\r\nhi\r\n"
+
+
+def test_push_between_replies():
+    class Protocol(ReaderProtocol):
+        def __init__(self):
+            super().__init__()
+            self.pushes = []
+
+        def push_received(self, reply):
+            self.pushes.append(reply)
+
+    async def main():
+        replies = [PUSH + b":1\r\n" + PUSH, b":2\r\n", PUSH + b":3\r\n"]
+        server, protocol = await connect(replies, Protocol)
+        async with server:
+            waiters = [protocol.request(b"INCR foo\r\n") for _ in replies]
+            assert [1, 2, 3] == await asyncio.gather(*waiters)
+            assert [[b"message", b"ch", b"hi"]] * 3 == protocol.pushes
+
+    asyncio.run(main())
+
+
+def test_push_handler_of_reader():
+    pushes = []
+
+    async def main():
+        reader = libvalkey.Reader(pushHandler=pushes.append)
+        server, protocol = await connect([PUSH + b"+OK\r\n"], lambda: ReaderProtocol(reader))
+        async with server:
+            assert pushes.append == reader.pushHandler
+            assert b"OK" == await protocol.request(b"SET foo bar\r\n")
+            assert [[b"message", b"ch", b"hi"]] == pushes
+
+    asyncio.run(main())
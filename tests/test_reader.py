@@ -1,3 +1,8 @@
+import array
+import asyncio
+import collections
+import threading
+
 import pytest
 
 import libvalkey
@@ -270,6 +275,28 @@ def test_decode_error_with_surrogateescape_errors():
     assert "\udc80value" == r.gets()
 
 
+@pytest.mark.parametrize(
+    "encoding", ["utf-8", "UTF8", "ascii", "latin-1", "ISO_8859_1", "utf-16"]
+)
+def test_decode_ascii(encoding):
+    value = "ascii value that spans more than a word".encode(encoding)
+    r = libvalkey.Reader(encoding=encoding)
+    r.feed(b"$%d\r\n%s\r\n" % (len(value), value))
+    assert value.decode(encoding) == r.gets()
+
+
+def test_decode_latin1():
+    r = libvalkey.Reader(encoding="latin-1")
+    r.feed(b"+caf\xe9 au lait\r\n")
+    assert "caf\xe9 au lait" == r.gets()
+
+
+def test_decode_ascii_errors():
+    r = libvalkey.Reader(encoding="ascii", errors="replace")
+    r.feed(b"+caf\xe9\r\n")
+    assert "caf\ufffd" == r.gets()
+
+
 def test_invalid_encoding():
     with pytest.raises(LookupError):
         libvalkey.Reader(encoding="unknown")
@@ -428,3 +455,894 @@ def test_reader_has_data(reader):
 def test_custom_not_enough_data():
     r = libvalkey.Reader(notEnoughData=Ellipsis)
     assert r.gets() == Ellipsis
+
+
+def test_gets_many(reader):
+    reader.feed(b"+ok\r\n:1\r\n*2\r\n$5\r\nhello\r\n$5\r\nworld\r\n")
+    assert [b"ok", 1, [b"hello", b"world"]] == reader.gets_many()
+    assert [] == reader.gets_many()
+
+
+def test_gets_many_partial_reply(reader):
+    reader.feed(b"+ok\r\n*2\r\n$5\r\nhello\r\n")
+    assert [b"ok"] == reader.gets_many()
+    reader.feed(b"$5\r\nworld\r\n")
+    assert [[b"hello", b"world"]] == reader.gets_many()
+
+
+def test_gets_many_max(reader):
+    reader.feed(b":1\r\n:2\r\n:3\r\n")
+    assert [1, 2] == reader.gets_many(2)
+    assert [] == reader.gets_many(max=0)
+    assert [3] == reader.gets_many(max=None)
+    with pytest.raises(ValueError):
+        reader.gets_many(-1)
+
+
+def test_gets_many_large_batch(reader):
+    reader.feed(b"".join(b":%d\r\n" % i for i in range(1000)))
+    assert list(range(300)) == reader.gets_many(300)
+    assert list(range(300, 1000)) == reader.gets_many()
+
+
+def test_gets_many_should_decode():
+    snowman = b"\xe2\x98\x83"
+    r = libvalkey.Reader(encoding="utf-8")
+    r.feed(b"$3\r\n" + snowman + b"\r\n")
+    assert [snowman] == r.gets_many(shouldDecode=False)
+    r.feed(b"$3\r\n" + snowman + b"\r\n")
+    assert [snowman.decode()] == r.gets_many()
+
+
+def test_gets_many_raises_error_after_replies():
+    r = libvalkey.Reader(encoding="utf-8")
+    r.feed(b"+ok\r\n+\x80\r\n+next\r\n")
+    assert ["ok"] == r.gets_many()
+    with pytest.raises(UnicodeDecodeError):
+        r.gets_many()
+    assert ["next"] == r.gets_many()
+
+
+def test_gets_many_protocol_error(reader):
+    reader.feed(b"+ok\r\nx")
+    assert [b"ok"] == reader.gets_many()
+    with pytest.raises(libvalkey.ProtocolError):
+        reader.gets_many()
+
+
+def test_get_buffer_commit(reader):
+    data = b"*2\r\n$5\r\nhello\r\n$5\r\nworld\r\n"
+    buf = reader.get_buffer()
+    assert len(buf) >= len(data)
+    buf[: len(data)] = data
+    reader.commit(len(data))
+    assert [b"hello", b"world"] == reader.gets()
+    assert not reader.gets()
+
+
+def test_get_buffer_sizehint(reader):
+    buf = reader.get_buffer(100000)
+    assert len(buf) >= 100000
+    reader.commit(0)
+
+
+def test_get_buffer_partial_reply(reader):
+    for chunk in (b"*2\r\n$5\r\nhel", b"lo\r\n$5\r\nworld\r\n"):
+        buf = reader.get_buffer(len(chunk))
+        buf[: len(chunk)] = chunk
+        reader.commit(len(chunk))
+    assert [b"hello", b"world"] == reader.gets()
+
+
+def test_get_buffer_mixed_with_feed(reader):
+    reader.feed(b"+ok\r\n")
+    buf = reader.get_buffer()
+    buf[:4] = b":1\r\n"
+    reader.commit(4)
+    reader.feed(b"+done\r\n")
+    assert [b"ok", 1, b"done"] == reader.gets_many()
+
+
+def test_get_buffer_recv_into(reader):
+    import socket
+
+    a, b = socket.socketpair()
+    with a, b:
+        b.sendall(b"$5\r\nhello\r\n")
+        reader.commit(a.recv_into(reader.get_buffer()))
+    assert b"hello" == reader.gets()
+
+
+def test_commit_invalid_size(reader):
+    with pytest.raises(ValueError):
+        reader.commit(1)
+    buf = reader.get_buffer()
+    with pytest.raises(ValueError):
+        reader.commit(len(buf) + 1)
+    with pytest.raises(ValueError):
+        reader.commit(-1)
+
+
+def test_commit_releases_view(reader):
+    buf = reader.get_buffer()
+    buf[:5] = b"+ok\r\n"
+    reader.commit(5)
+    with pytest.raises(ValueError):
+        buf[0]
+    assert b"ok" == reader.gets()
+
+
+def test_gets_drops_reservation(reader):
+    # Reading the first reply moves the rest of the data to the start of the
+    # buffer, so the reservation can't be committed afterwards.
+    reader.feed(b"$1100\r\n" + b"a" * 1100 + b"\r\n:1")
+    buf = reader.get_buffer()
+    assert b"a" * 1100 == reader.gets()
+    with pytest.raises(ValueError):
+        buf[:3] = b"\r\n:"
+    with pytest.raises(ValueError):
+        reader.commit(3)
+    assert False is reader.gets()
+    reader.feed(b"\r\n")
+    assert 1 == reader.gets()
+
+
+def test_gets_with_exported_buffer(reader):
+    view = reader.get_buffer()[:5]
+    with pytest.raises(BufferError):
+        reader.gets()
+    view.release()
+    assert False is reader.gets()
+
+
+def test_feed_with_exported_buffer(reader):
+    view = reader.get_buffer()[:5]
+    with pytest.raises(BufferError):
+        reader.feed(b"+ok\r\n")
+    view.release()
+    reader.feed(b"+ok\r\n")
+    assert b"ok" == reader.gets()
+
+
+def test_buffer_without_reservation(reader):
+    with pytest.raises(BufferError):
+        memoryview(reader)
+
+
+def futures(count):
+    loop = asyncio.new_event_loop()
+    loop.close()
+    return collections.deque(loop.create_future() for _ in range(count))
+
+
+def test_resolve(reader):
+    waiters = futures(2)
+    first, second = waiters
+    data = b"+ok\r\n:"
+    reader.get_buffer()[:len(data)] = data
+    assert 1 == reader.resolve(waiters, len(data))
+    assert b"ok" == first.result()
+    assert not second.done()
+    reader.feed(b"1\r\n")
+    assert 1 == reader.resolve(waiters)
+    assert 1 == second.result()
+    assert not waiters
+
+
+def test_resolve_keeps_replies_without_waiters(reader):
+    reader.feed(b"+ok\r\n:1\r\n")
+    waiters = futures(1)
+    first = waiters[0]
+    assert 1 == reader.resolve(waiters)
+    assert b"ok" == first.result()
+    assert 1 == reader.gets()
+
+
+def test_resolve_skips_done_futures(reader):
+    waiters = futures(2)
+    first, second = waiters
+    first.cancel()
+    reader.feed(b"+a\r\n+b\r\n")
+    assert 2 == reader.resolve(waiters)
+    assert b"b" == second.result()
+
+
+def test_resolve_reply_errors(reader):
+    waiters = futures(3)
+    first, second, third = waiters
+    reader.set_encoding(encoding="utf-8")
+    reader.feed(b"-ERR no\r\n$1\r\n\xff\r\n+ok\r\n")
+    assert 3 == reader.resolve(waiters)
+    assert isinstance(first.result(), libvalkey.ReplyError)
+    assert isinstance(second.exception(), UnicodeDecodeError)
+    assert "ok" == third.result()
+
+
+def test_resolve_protocol_error(reader):
+    waiters = futures(1)
+    reader.feed(b"x")
+    with pytest.raises(libvalkey.ProtocolError):
+        reader.resolve(waiters)
+    assert not waiters[0].done()
+
+
+def test_lazy_array():
+    reader = libvalkey.Reader(lazy=True)
+    reader.feed(b"*4\r\n$3\r\nfoo\r\n:1\r\n,1.5\r\n_\r\n")
+    reply = reader.gets()
+    assert isinstance(reply, libvalkey.LazyList)
+    assert 4 == len(reply)
+    assert b"foo" == reply[0]
+    assert None is reply[-1]
+    assert [1, 1.5] == reply[1:3]
+    assert [b"foo", 1, 1.5, None] == reply.tolist()
+    assert [b"foo", 1, 1.5, None] == reply
+    with pytest.raises(IndexError):
+        reply[4]
+
+
+def test_lazy_map():
+    reader = libvalkey.Reader(lazy=True, encoding="utf-8")
+    reader.feed(b"%3\r\n+a\r\n:1\r\n+b\r\n*2\r\n#t\r\n=8\r\ntxt:text\r\n+a\r\n:2\r\n")
+    reply = reader.gets()
+    assert isinstance(reply, libvalkey.LazyMap)
+    assert 3 == len(reply)
+    assert 2 == reply["a"]
+    assert isinstance(reply["b"], libvalkey.LazyList)
+    assert [True, "text"] == reply["b"]
+    assert "b" in reply
+    assert b"b" not in reply
+    assert None is reply.get("c")
+    assert ["a", "b", "a"] == list(reply)
+    assert [("a", 1), ("b", [True, "text"]), ("a", 2)] == reply.items()
+    assert {"a": 2, "b": [True, "text"]} == reply.todict()
+    with pytest.raises(KeyError):
+        reply["c"]
+
+
+def test_lazy_decode_error_on_access():
+    reader = libvalkey.Reader(lazy=True, encoding="utf-8")
+    reader.feed(b"*2\r\n$2\r\n\xff\xff\r\n:1\r\n")
+    reply = reader.gets()
+    assert 1 == reply[1]
+    with pytest.raises(UnicodeDecodeError):
+        reply[0]
+
+
+def test_lazy_reply_error():
+    reader = libvalkey.Reader(lazy=True)
+    reader.feed(b"*1\r\n-ERR error\r\n")
+    reply = reader.gets()
+    assert isinstance(reply[0], libvalkey.ReplyError)
+
+
+def test_lazy_no_decode():
+    reader = libvalkey.Reader(lazy=True, encoding="utf-8")
+    reader.feed(b"*1\r\n$3\r\nfoo\r\n")
+    assert [b"foo"] == reader.gets(False)
+
+
+def test_gets_raw(reader):
+    data = b"+ok\r\n*3\r\n$3\r\nfoo\r\n%1\r\n+a\r\n*-1\r\n$-1\r\n:1\r\n"
+    reader.feed(data)
+    assert b"+ok\r\n" == reader.gets_raw()
+    assert b"*3\r\n$3\r\nfoo\r\n%1\r\n+a\r\n*-1\r\n$-1\r\n" == reader.gets_raw()
+    assert b":1\r\n" == reader.gets_raw()
+    assert False is reader.gets_raw()
+
+
+def test_gets_raw_partial(reader):
+    data = b"*2\r\n$5\r\nhello\r\n=8\r\ntxt:text\r\n"
+    for i in range(len(data) - 1):
+        reader.feed(data[i : i + 1])
+        assert False is reader.gets_raw()
+    reader.feed(data[-1:])
+    assert data == reader.gets_raw()
+
+
+def test_gets_raw_line_endings(reader):
+    data = b"*3\r\n$70\r\n" + b"\r\n" * 35 + b"\r\n+" + b"x" * 100 + b"\r\n$3\r\n\r\r\n\r\n"
+    reader.feed(data + b":1\r\n")
+    assert data == reader.gets_raw()
+    assert b":1\r\n" == reader.gets_raw()
+
+
+def test_gets_raw_then_gets(reader):
+    reader.feed(b"$3\r\nfoo\r\n" * 500 + b":1\r\n")
+    for _ in range(500):
+        assert b"$3\r\nfoo\r\n" == reader.gets_raw()
+    assert 1 == reader.gets()
+
+
+def test_gets_raw_protocol_error(reader):
+    reader.feed(b"x")
+    with pytest.raises(libvalkey.ProtocolError):
+        reader.gets_raw()
+
+
+def test_gets_raw_during_gets(reader):
+    reader.feed(b"*2\r\n:1\r\n")
+    assert False is reader.gets()
+    with pytest.raises(RuntimeError):
+        reader.gets_raw()
+
+
+def test_intern_keys():
+    reader = libvalkey.Reader(internKeys=16, encoding="utf-8")
+    reader.feed(b"%1\r\n+key\r\n+value\r\n" * 2)
+    first, second = reader.gets(), reader.gets()
+    assert {"key": "value"} == first == second
+    assert next(iter(first)) is next(iter(second))
+
+
+def test_intern_keys_decode_settings():
+    reader = libvalkey.Reader(internKeys=16, encoding="utf-8")
+    reader.feed(b"%1\r\n+key\r\n:1\r\n" * 3)
+    assert {"key": 1} == reader.gets()
+    assert {b"key": 1} == reader.gets(False)
+    reader.set_encoding(encoding=None)
+    assert {b"key": 1} == reader.gets()
+
+
+def test_intern_keys_negative():
+    with pytest.raises(ValueError):
+        libvalkey.Reader(internKeys=-1)
+
+
+def test_push_handler():
+    pushes = []
+    reader = libvalkey.Reader(pushHandler=pushes.append)
+    reader.feed(b">2\r\n+invalidate\r\n*1\r\n+key\r\n:1\r\n>1\r\n+message\r\n")
+    assert 1 == reader.gets()
+    assert [[b"invalidate", [b"key"]]] == pushes
+    assert False is reader.gets()
+    assert [[b"invalidate", [b"key"]], [b"message"]] == pushes
+
+
+def test_push_handler_nested_push_is_kept():
+    pushes = []
+    reader = libvalkey.Reader(pushHandler=pushes.append)
+    reader.feed(b"*1\r\n>1\r\n+message\r\n")
+    assert [[b"message"]] == reader.gets()
+    assert [] == pushes
+
+
+def test_push_handler_gets_many():
+    pushes = []
+    reader = libvalkey.Reader(pushHandler=pushes.append)
+    reader.feed(b":1\r\n>1\r\n+message\r\n:2\r\n")
+    assert [1, 2] == reader.gets_many()
+    assert [[b"message"]] == pushes
+
+
+def test_push_handler_error():
+    def handler(push):
+        raise ValueError(push)
+
+    reader = libvalkey.Reader(pushHandler=handler)
+    reader.feed(b">1\r\n+message\r\n:1\r\n")
+    with pytest.raises(ValueError):
+        reader.gets()
+    assert 1 == reader.gets()
+
+
+def test_set_push_handler(reader):
+    pushes = []
+    reader.feed(b">1\r\n+first\r\n>1\r\n+second\r\n")
+    assert [b"first"] == reader.gets()
+    reader.set_push_handler(pushes.append)
+    assert False is reader.gets()
+    assert [[b"second"]] == pushes
+    reader.set_push_handler(None)
+    with pytest.raises(TypeError):
+        reader.set_push_handler(1)
+
+
+def test_stream_handler():
+    chunks = []
+    reader = libvalkey.Reader(streamHandler=chunks.append, streamThreshold=10)
+    reader.feed(b"$12\r\nhello")
+    assert False is reader.gets()
+    assert [b"hello"] == chunks
+    reader.feed(b" world!\r")
+    assert False is reader.gets()
+    reader.feed(b"\n$3\r\nfoo\r\n")
+    assert libvalkey.StreamedReply(12) == reader.gets()
+    assert b"hello world!" == b"".join(chunks)
+    assert b"foo" == reader.gets()
+
+
+def test_streamed_reply():
+    reader = libvalkey.Reader(streamHandler=lambda chunk: None, streamThreshold=3)
+    reader.feed(b"$3\r\nfoo\r\n:3\r\n")
+    streamed, integer = reader.gets_many()
+    assert isinstance(streamed, libvalkey.StreamedReply)
+    assert 3 == streamed.size
+    assert "StreamedReply(size=3)" == repr(streamed)
+    assert streamed != integer
+    assert streamed != libvalkey.StreamedReply(4)
+    assert {streamed} == {libvalkey.StreamedReply(size=3)}
+    with pytest.raises(ValueError):
+        libvalkey.StreamedReply(-1)
+
+
+def test_stream_handler_only_top_level():
+    chunks = []
+    reader = libvalkey.Reader(streamHandler=chunks.append, streamThreshold=1)
+    reader.feed(b"*1\r\n$3\r\nfoo\r\n$-1\r\n$0\r\n\r\n")
+    assert [[b"foo"], None, b""] == reader.gets_many()
+    assert [] == chunks
+
+
+def test_stream_handler_partial_header():
+    chunks = []
+    reader = libvalkey.Reader(streamHandler=chunks.append, streamThreshold=3)
+    reader.feed(b"$")
+    assert False is reader.gets()
+    reader.feed(b"3\r")
+    assert False is reader.gets()
+    reader.feed(b"\nfoo\r\n")
+    assert libvalkey.StreamedReply(3) == reader.gets()
+    assert [b"foo"] == chunks
+
+
+def test_stream_handler_error():
+    def handler(chunk):
+        raise ValueError(chunk)
+
+    reader = libvalkey.Reader(streamHandler=handler, streamThreshold=3)
+    reader.feed(b"$3\r\nfoo\r\n:1\r\n")
+    with pytest.raises(ValueError):
+        reader.gets()
+    assert libvalkey.StreamedReply(3) == reader.gets()
+    assert 1 == reader.gets()
+
+
+def test_set_stream_handler(reader):
+    chunks = []
+    reader.set_stream_handler(chunks.append)
+    reader.feed(b"$2000000\r\n" + b"x" * 1000000)
+    assert False is reader.gets()
+    with pytest.raises(RuntimeError):
+        reader.gets_raw()
+    reader.set_stream_handler(None)
+    reader.feed(b"x" * 1000000 + b"\r\n")
+    assert 2000000 == reader.gets().size
+    assert [b"x" * 1000000] == chunks
+    with pytest.raises(TypeError):
+        reader.set_stream_handler(1)
+    with pytest.raises(ValueError):
+        libvalkey.Reader(streamThreshold=0)
+
+
+def test_stream_handler_reset():
+    chunks = []
+    reader = libvalkey.Reader(streamHandler=chunks.append, streamThreshold=3)
+    reader.feed(b"$5\r\nfoo")
+    assert False is reader.gets()
+    reader.reset()
+    reader.feed(b"+OK\r\n")
+    assert b"OK" == reader.gets()
+
+
+def test_gets_ints(reader):
+    reader.feed(b":1\r\n:-9223372036854775808\r\n:3\r\n")
+    ints = reader.gets_ints()
+    assert isinstance(ints, array.array)
+    assert [1, -9223372036854775808, 3] == ints.tolist()
+    assert [] == reader.gets_ints().tolist()
+
+
+def test_gets_ints_other_reply(reader):
+    reader.feed(b":1\r\n$1\r\nx\r\n")
+    with pytest.raises(libvalkey.ProtocolError, match="type '\\$'") as excinfo:
+        reader.gets_ints()
+    assert [1] == excinfo.value.result.tolist()
+    # The reply is left for gets.
+    assert b"x" == reader.gets()
+    reader.feed(b":1")
+    assert [] == reader.gets_ints().tolist()
+
+
+def test_gets_ints_max(reader):
+    reader.feed(b":1\r\n:2\r\n:3")
+    assert [1] == reader.gets_ints(1).tolist()
+    assert [2] == reader.gets_ints().tolist()
+    reader.feed(b"\r\n")
+    assert [3] == reader.gets_ints(5).tolist()
+
+
+def test_gets_ints_error(reader):
+    reader.feed(b":1\r\n-ERR error\r\n:3\r\n")
+    with pytest.raises(libvalkey.ReplyError, match="ERR error") as excinfo:
+        reader.gets_ints()
+    assert [1] == excinfo.value.result.tolist()
+    assert [3] == reader.gets_ints().tolist()
+
+
+def test_gets_ints_push():
+    pushes = []
+    r = libvalkey.Reader(pushHandler=pushes.append)
+    r.feed(b":1\r\n>2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nfoo\r\n:2\r\n>1\r\n")
+    assert [1, 2] == r.gets_ints().tolist()
+    assert [[b"invalidate", [b"foo"]]] == pushes
+    r.feed(b"+x\r\n:3\r\n")
+    assert [3] == r.gets_ints().tolist()
+    assert [[b"x"]] == pushes[1:]
+
+
+def test_expect_ok(reader):
+    reader.feed(b"+OK\r\n+OK\r\n+O")
+    assert 2 == reader.expect_ok()
+    assert 0 == reader.expect_ok()
+    reader.feed(b"K\r\n")
+    assert 1 == reader.expect_ok(5)
+
+
+def test_expect_ok_other_reply(reader):
+    reader.feed(b"+OK\r\n+QUEUED\r\n:1\r\n")
+    with pytest.raises(libvalkey.ProtocolError, match="QUEUED") as excinfo:
+        reader.expect_ok(5)
+    assert 1 == excinfo.value.result
+    # The reply is left for gets, and the reader can still be used.
+    assert b"QUEUED" == reader.gets()
+    with pytest.raises(libvalkey.ProtocolError):
+        reader.expect_ok()
+    assert 1 == reader.gets()
+    reader.feed(b"+QUE")
+    assert 0 == reader.expect_ok()
+
+
+def test_expect_ok_error(reader):
+    reader.feed(b"+OK\r\n-ERR error\r\n+OK\r\n")
+    with pytest.raises(libvalkey.ReplyError, match="ERR error") as excinfo:
+        reader.expect_ok()
+    assert 1 == excinfo.value.result
+    assert 1 == reader.expect_ok(1)
+
+
+def test_expect_ok_push():
+    pushes = []
+    r = libvalkey.Reader(pushHandler=pushes.append)
+    r.feed(b"+OK\r\n>2\r\n$10\r\ninvalidate\r\n*1\r\n$3\r\nfoo\r\n+OK\r\n")
+    assert 2 == r.expect_ok()
+    assert [[b"invalidate", [b"foo"]]] == pushes
+    # Without a handler, the push is returned by gets.
+    r.set_push_handler(None)
+    r.feed(b">1\r\n+x\r\n")
+    with pytest.raises(libvalkey.ProtocolError, match="type '>'"):
+        r.expect_ok()
+    assert [b"x"] == r.gets()
+
+
+def test_expect_ok_callable_errors():
+    r = libvalkey.Reader(protocolError=lambda m: ValueError(m), replyError=lambda m: m)
+    r.feed(b"+QUEUED\r\n")
+    with pytest.raises(ValueError, match="QUEUED"):
+        r.expect_ok()
+    assert b"QUEUED" == r.gets()
+    # A replyError that doesn't create an exception raises ReplyError.
+    r.feed(b"-ERR x\r\n:1\r\n-ERR y\r\n")
+    with pytest.raises(libvalkey.ReplyError, match="ERR x"):
+        r.expect_ok()
+    with pytest.raises(ValueError, match="type ':'"):
+        r.expect_ok()
+    assert 1 == r.gets()
+    with pytest.raises(libvalkey.ReplyError, match="ERR y"):
+        r.gets_ints()
+
+
+def test_typed_gets_during_gets(reader):
+    reader.feed(b"*2\r\n:1\r\n")
+    assert False is reader.gets()
+    with pytest.raises(RuntimeError):
+        reader.gets_ints()
+    with pytest.raises(RuntimeError):
+        reader.expect_ok()
+
+
+def test_shared_reader_threads():
+    reader = libvalkey.Reader()
+    replies = []
+
+    def work():
+        for _ in range(200):
+            reader.feed(b"*2\r\n:1\r\n:2\r\n")
+            replies.extend(reader.gets_many())
+
+    threads = [threading.Thread(target=work) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert [[1, 2]] * 800 == replies
+
+
+RELEASE_GIL_REPLIES = [
+    b"*3\r\n$3\r\nfoo\r\n:42\r\n*2\r\n+OK\r\n$-1\r\n",
+    b"%2\r\n+a\r\n,1.5\r\n$1\r\nb\r\n~2\r\n#t\r\n_\r\n",
+    b"*5\r\n,inf\r\n(12345678901234567890\r\n=8\r\ntxt:abcd\r\n-ERR x\r\n*-1\r\n",
+    b"*100\r\n" + b"$5\r\nvalue\r\n" * 100,
+    b"*4\r\n$70\r\n" + b"\r" * 70 + b"\r\n+" + b"x" * 100 +
+    b"\r\n:-999999999999999999\r\n:9223372036854775807\r\n",
+]
+
+
+@pytest.mark.parametrize("data", RELEASE_GIL_REPLIES)
+def test_release_gil(data):
+    expected = libvalkey.Reader()
+    expected.feed(data)
+    reader = libvalkey.Reader(releaseGilThreshold=1)
+    for i in range(len(data)):
+        reader.feed(data[i:i + 1])
+        reply = reader.gets()
+        if i < len(data) - 1:
+            assert reply is False
+    assert repr(expected.gets()) == repr(reply)
+
+
+def test_release_gil_lazy():
+    reader = libvalkey.Reader(releaseGilThreshold=1, lazy=True, encoding="utf-8")
+    reader.feed(b"%2\r\n+name\r\n+valkey\r\n+tags\r\n*2\r\n+a\r\n+b\r\n")
+    assert {"name": "valkey", "tags": ["a", "b"]} == reader.gets()
+
+
+def test_release_gil_protocol_error():
+    reader = libvalkey.Reader(releaseGilThreshold=1)
+    reader.feed(b"*2\r\n:1\r\n:x\r\n")
+    with pytest.raises(libvalkey.ProtocolError, match="Bad integer value"):
+        reader.gets()
+
+
+def test_release_gil_push_handler():
+    pushes = []
+    reader = libvalkey.Reader(releaseGilThreshold=1, pushHandler=pushes.append)
+    reader.feed(b">2\r\n$7\r\nmessage\r\n$2\r\nhi\r\n*1\r\n:1\r\n")
+    assert [1] == reader.gets()
+    assert [[b"message", b"hi"]] == pushes
+
+
+def test_release_gil_threshold_negative():
+    with pytest.raises(ValueError):
+        libvalkey.Reader(releaseGilThreshold=-1)
+
+
+def test_columnar_numbers():
+    reader = libvalkey.Reader(columnar=True)
+    reader.feed(b"*3\r\n:1\r\n:-2\r\n:3\r\n*2\r\n,1.5\r\n:2\r\n~1\r\n,inf\r\n")
+    assert [
+        array.array("q", [1, -2, 3]),
+        array.array("d", [1.5, 2.0]),
+        array.array("d", [float("inf")]),
+    ] == reader.gets_many()
+
+
+def test_columnar_bulk_strings():
+    reader = libvalkey.Reader(columnar=True)
+    reader.feed(b"*2\r\n$2\r\n10\r\n$2\r\n-1\r\n")
+    reader.feed(b"*2\r\n$3\r\n1.5\r\n$1\r\n2\r\n")
+    reader.feed(b"*3\r\n$3\r\nfoo\r\n$0\r\n\r\n$2\r\nba\r\n")
+    assert array.array("q", [10, -1]) == reader.gets()
+    assert array.array("d", [1.5, 2.0]) == reader.gets()
+    offsets, data = reader.gets()
+    assert array.array("q", [0, 3, 3, 5]) == offsets
+    assert b"fooba" == data
+
+
+@pytest.mark.parametrize("strings", [[b"007", b"010"], [b"1.5", b"nan"], [b"inf"], [b"1e5"], [b"2.50"]])
+def test_columnar_non_canonical_numbers(strings):
+    reader = libvalkey.Reader(columnar=True)
+    reader.feed(b"*%d\r\n" % len(strings))
+    for string in strings:
+        reader.feed(b"$%d\r\n%s\r\n" % (len(string), string))
+    offsets, data = reader.gets()
+    assert b"".join(strings) == data
+    assert len(strings) + 1 == len(offsets)
+
+
+def test_columnar_mixed():
+    reader = libvalkey.Reader(columnar=True)
+    reader.feed(b"*2\r\n$3\r\nfoo\r\n$-1\r\n*2\r\n*1\r\n:1\r\n:2\r\n")
+    reader.feed(b"%1\r\n+key\r\n*1\r\n:1\r\n*0\r\n")
+    assert [b"foo", None] == reader.gets()
+    assert [array.array("q", [1]), 2] == reader.gets()
+    assert {b"key": array.array("q", [1])} == reader.gets()
+    assert [] == reader.gets()
+
+
+def test_columnar_empty():
+    reader = libvalkey.Reader(columnar=True)
+    reader.feed(b"*0\r\n~0\r\n*1\r\n*0\r\n")
+    assert [[], set(), [[]]] == reader.gets_many()
+
+
+def test_columnar_partial():
+    reader = libvalkey.Reader(columnar=True)
+    data = b"*3\r\n:1\r\n:2\r\n:3\r\n"
+    for i in range(len(data) - 1):
+        reader.feed(data[i:i + 1])
+        assert False is reader.gets()
+    reader.feed(data[-1:])
+    assert array.array("q", [1, 2, 3]) == reader.gets()
+
+
+HASH_REPLY = (
+    b"*8\r\n$4\r\nname\r\n$3\r\nbob\r\n$3\r\nage\r\n$2\r\n42\r\n"
+    b"$5\r\nscore\r\n:3\r\n$4\r\ntags\r\n*1\r\n$1\r\na\r\n"
+)
+
+
+@pytest.mark.parametrize("options", [{}, {"releaseGilThreshold": 1}, {"lazy": True}])
+def test_transform(options):
+    reader = libvalkey.Reader(**options)
+    user = libvalkey.ReplyTransform("fields", {"name": str, "age": int, "score": float, "x": None})
+    reader.feed(HASH_REPLY * 3)
+    reply = reader.gets(transform=libvalkey.ReplyTransform("dict"))
+    assert {b"name": b"bob", b"age": b"42", b"score": 3, b"tags": [b"a"]} == reply
+    reply = reader.gets(transform=libvalkey.ReplyTransform("pairs"))
+    assert [(b"name", b"bob"), (b"age", b"42"), (b"score", 3), (b"tags", [b"a"])] == reply
+    assert ("bob", 42, 3.0, None) == reader.gets(transform=user)
+    assert False is reader.gets(transform=user)
+
+
+def test_transform_partial():
+    reader = libvalkey.Reader()
+    user = libvalkey.ReplyTransform("fields", ["age", "tags"])
+    for i in range(len(HASH_REPLY) - 1):
+        reader.feed(HASH_REPLY[i:i + 1])
+        assert False is reader.gets(transform=user)
+    reader.feed(HASH_REPLY[-1:])
+    # The reply keeps the transform it was started with.
+    assert (b"42", [b"a"]) == reader.gets()
+
+
+def test_transform_factory():
+    user = collections.namedtuple("User", "age name")
+    transform = libvalkey.ReplyTransform("fields", user._fields, factory=user)
+    reader = libvalkey.Reader(encoding="utf-8")
+    reader.feed(HASH_REPLY * 2)
+    assert [user("42", "bob")] * 2 == reader.gets_many(transform=transform)
+
+
+def test_transform_map():
+    reader = libvalkey.Reader(internKeys=16)
+    reader.feed(b"%2\r\n+a\r\n:1\r\n+b\r\n*2\r\n:1\r\n:2\r\n" * 2)
+    assert {b"a": 1, b"b": [1, 2]} == reader.gets(transform=libvalkey.ReplyTransform("dict"))
+    assert (1, [1, 2]) == reader.gets(
+        transform=libvalkey.ReplyTransform("fields", {b"a": None, b"b": None})
+    )
+
+
+def test_transform_other_replies():
+    reader = libvalkey.Reader()
+    transform = libvalkey.ReplyTransform("dict")
+    reader.feed(b"*3\r\n:1\r\n:2\r\n:3\r\n-ERR x\r\n:1\r\n>2\r\n+a\r\n+b\r\n")
+    assert [1, 2, 3] == reader.gets(transform=transform)
+    assert isinstance(reader.gets(transform=transform), libvalkey.ReplyError)
+    assert [1, [b"a", b"b"]] == reader.gets_many(transform=transform)
+
+
+@pytest.mark.parametrize("options", [{}, {"releaseGilThreshold": 1}])
+def test_transform_numbers(options):
+    reader = libvalkey.Reader(**options)
+    fields = {"a": str, "b": int, "c": bytes, "d": float, "e": str, "f": None}
+    transform = libvalkey.ReplyTransform("fields", fields)
+    reader.feed(
+        b"%6\r\n+a\r\n:5\r\n+b\r\n,1000\r\n+c\r\n:-7\r\n"
+        b"+d\r\n:2\r\n+e\r\n,1.5\r\n+f\r\n,2.5\r\n"
+    )
+    assert ("5", 1000, b"-7", 2.0, "1.5", 2.5) == reader.gets(transform=transform)
+
+
+def test_transform_number_conversion_error():
+    reader = libvalkey.Reader()
+    reader.feed(b"%1\r\n+a\r\n,1.5\r\n:1\r\n")
+    with pytest.raises(ValueError):
+        reader.gets(transform=libvalkey.ReplyTransform("fields", {"a": int}))
+    assert 1 == reader.gets()
+
+
+def test_transform_conversion_error():
+    reader = libvalkey.Reader()
+    reader.feed(b"*2\r\n$3\r\nage\r\n$3\r\nabc\r\n:1\r\n")
+    with pytest.raises(ValueError):
+        reader.gets(transform=libvalkey.ReplyTransform("fields", {"age": int}))
+    assert 1 == reader.gets()
+
+
+def test_transform_arguments():
+    reader = libvalkey.Reader()
+    with pytest.raises(TypeError):
+        reader.gets(transform={})
+    with pytest.raises(ValueError):
+        libvalkey.ReplyTransform("list")
+    with pytest.raises(TypeError):
+        libvalkey.ReplyTransform("fields")
+    with pytest.raises(TypeError):
+        libvalkey.ReplyTransform("dict", ["a"])
+    with pytest.raises(TypeError):
+        libvalkey.ReplyTransform("fields", {"a": list})
+
+
+def test_reset_after_protocol_error(reader):
+    reader.feed(b"x")
+    with pytest.raises(libvalkey.ProtocolError):
+        reader.gets()
+    reader.reset()
+    reader.feed(b"+ok\r\n")
+    assert b"ok" == reader.gets()
+
+
+def test_reset_partial_reply(reader):
+    reader.feed(b"%2\r\n+a\r\n:1\r\n+b\r\n")
+    assert False is reader.gets()
+    reader.reset()
+    assert 0 == reader.len()
+    reader.feed(b"*1\r\n:1\r\n")
+    assert [1] == reader.gets()
+
+
+def test_reset_pending_error(reader):
+    reader.feed(b":1\r\nx")
+    assert [1] == reader.gets_many()
+    reader.reset()
+    reader.feed(b":2\r\n")
+    assert 2 == reader.gets()
+
+
+def test_reset_keep(reader):
+    reader.feed(b"$3\r\nfoo\r\n")
+    reader.reset(keep=0)
+    assert False is reader.has_data()
+    with pytest.raises(ValueError):
+        reader.reset(keep=-1)
+
+
+def test_allocator_stats():
+    before = libvalkey.allocator_stats()
+    reader = libvalkey.Reader()
+    reader.feed(b"$100000\r\n" + b"x" * 100000 + b"\r\n")
+    assert 100000 == len(reader.gets())
+    during = libvalkey.allocator_stats()
+    assert during["allocations"] > before["allocations"]
+    assert during["bytes"] >= before["bytes"] + 100000
+    del reader
+    after = libvalkey.allocator_stats()
+    assert after["frees"] > during["frees"]
+    assert after["bytes"] == before["bytes"]
+
+
+def test_stats_disabled(reader):
+    assert None is reader.stats()
+    reader.reset_stats()
+
+
+def test_stats():
+    reader = libvalkey.Reader(stats=True, encoding="utf-8")
+    reader.feed(b"*3\r\n:1\r\n$3\r\nfoo\r\n$1\r\n\xff\r\n+OK\r\n")
+    with pytest.raises(UnicodeDecodeError):
+        reader.gets()
+    assert "OK" == reader.gets()
+    stats = reader.stats()
+    assert 29 == stats["bytes_fed"]
+    assert 2 == stats["replies"]
+    assert 1 == stats["elements"]["array"]
+    assert 2 == stats["elements"]["string"]
+    assert 1 == stats["elements"]["status"]
+    assert 1 == stats["decode_errors"]
+    assert stats["buffer_peak"] >= 29
+    assert reader.getmaxbuf() == stats["maxbuf"]
+
+    reader.reset_stats()
+    stats = reader.stats()
+    assert 0 == stats["bytes_fed"]
+    assert 0 == stats["replies"]
+    assert 0 == stats["parse_ns"]
+
+
+def test_stats_buffer():
+    reader = libvalkey.Reader(stats=True)
+    reader.feed(b"x" * 100000)
+    stats = reader.stats()
+    assert stats["buffer_reallocations"] >= 1
+    assert stats["buffer_peak"] >= 100000